@@ -34,12 +34,18 @@
 #include <linux/mutex.h>
 #include <linux/videodev2.h>
 #include <linux/kthread.h>
+#include <linux/cpu.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/hash.h>
 #include <mach/iomux.h>
 #include <media/v4l2-common.h>
 #include <media/v4l2-dev.h>
 #include <media/videobuf-dma-contig.h>
 #include <media/soc_camera.h>
 #include <media/soc_mediabus.h>
+#include <media/rk_camera_notify.h>
 #include <mach/io.h>
 #include <plat/ipp.h>
 #include <plat/vpu_service.h>
@@ -58,6 +64,9 @@
 #endif
 #include <asm/cacheflush.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/rk_camera.h>
+
 static int debug;
 module_param(debug, int, S_IRUGO|S_IWUSR);
 
@@ -233,21 +242,58 @@ module_param(debug, int, S_IRUGO|S_IWUSR);
 
 #define CAM_WORKQUEUE_IS_EN()  (true)
 #define CAM_IPPWORK_IS_EN()     ((pcdev->zoominfo.a.c.width != pcdev->icd->user_width) || (pcdev->zoominfo.a.c.height != pcdev->icd->user_height))
+#define CAM_PINGPONG_IS_EN()    (pcdev->work_mode == MODE_PINGPONG)
+/* NTSC/PAL(CCIR656) input is interlaced, it is deinterlaced by ipp */
+#define CAM_INTERLACE_IS_EN()   (((read_cif_reg(pcdev->base,CIF_CIF_FOR) & (0x07<<2)) == INPUT_MODE_NTSC) \
+                                    || ((read_cif_reg(pcdev->base,CIF_CIF_FOR) & (0x07<<2)) == INPUT_MODE_PAL))
+/* cif output is the same as videobuf, so cif dma into videobuf and it is done in irq */
+#define CAM_DIRECT_IS_EN()      (direct_capture && !CAM_IPPWORK_IS_EN() && !CAM_INTERLACE_IS_EN() \
+                                    && (pcdev->zoominfo.vir_width == pcdev->icd->user_width) \
+                                    && (pcdev->zoominfo.vir_height == pcdev->icd->user_height) \
+                                    && (pcdev->icd->current_fmt->host_fmt->fourcc != V4L2_PIX_FMT_RGB565) \
+                                    && (pcdev->icd->current_fmt->host_fmt->fourcc != V4L2_PIX_FMT_RGB24) \
+                                    && (pcdev->icd_cb.sensor_cb == NULL))
+
+#if defined(CONFIG_ARCH_RK3188)
+#define CIF_PINGPONG_DEFAULT    0           /* pingpong mode hasn't been verified on rk3188 */
+#else
+#define CIF_PINGPONG_DEFAULT    1
+#endif
 
 #define IS_CIF0()		(pcdev->hostid == RK_CAM_PLATFORM_DEV_ID_0)
-#if (CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_IPP)
-#define CROP_ALIGN_BYTES (0x03)
-#define CIF_DO_CROP 0
-#elif (CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_ARM)
-#define CROP_ALIGN_BYTES (0x0f)
-#define CIF_DO_CROP 0
-#elif (CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_RGA)
-#define CROP_ALIGN_BYTES (0x03)
-#define CIF_DO_CROP 0
-#elif(CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_PP)
+/*
+* PP does crop in cif, so it is still selected at compile time; the others(IPP, ARM and RGA if rga driver is built)
+* are all built in, and selected for each stream in rk_camera_scale_crop_select. RGA is only used if scale_crop is 2
+* when cif is probed, it is default if RK_CAM_SCALE_CROP_RGA is the machine.
+*/
+#if(CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_PP)
 #define CROP_ALIGN_BYTES (0x0F)
 #define CIF_DO_CROP 1
+#define RK_CAM_SCALE_CROP_SEL 0
+#define RK_CAM_SCALE_CROP_RGA_EN 0
+#else
+#define CROP_ALIGN_BYTES (pcdev->crop_align)
+#define CIF_DO_CROP 0
+#define RK_CAM_SCALE_CROP_SEL 1
+#if defined(CONFIG_ROCKCHIP_RGA) || (CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_RGA)
+#define RK_CAM_SCALE_CROP_RGA_EN 1
+#else
+#define RK_CAM_SCALE_CROP_RGA_EN 0
+#endif
+#endif
+#if (CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_RGA)
+#define RK_CAM_SCALE_CROP_DEFAULT 2
+#else
+#define RK_CAM_SCALE_CROP_DEFAULT 0
 #endif
+
+#define RK_CAM_ENGINE_ARM       0
+#define RK_CAM_ENGINE_IPP       1
+#define RK_CAM_ENGINE_RGA       2
+#define RK_CAM_ENGINE_PP        3
+#define RK_CAM_ENGINE_NUM       4
+#define RK_CAM_ENGINE_ARM_SIZE  (352*288)       /* arm is used for small output, if there isn't cost measured */
+#define RK_CAM_SCALE_PROBE_FRAME 2              /* the other engine is run on this frame of stream to measure its cost */
 //Configure Macro
 /*
 *			 Driver Version Note
@@ -333,12 +379,70 @@ module_param(debug, int, S_IRUGO|S_IWUSR);
 *         2. Reset cif and Reinit sensor when cif havn't receive data first;
 *v0.3.0x15:
 *         1. fix access cif register in rk_camera_remove_device, it may be happen before clock turn on;
+*v0.3.0x16:
+*         1. support cif pingpong mode, FRM0 and FRM1 are filled with different videobuf from capture list;
+*v0.3.0x17:
+*         1. rk3188 cif isn't soft reset after each frame, only reset when cif irq is abnormal;
+*         2. count captured frames and cif reset times in irqinfo;
+*v0.3.0x18:
+*         1. optimize rk_camera_scale_crop_arm inner loop, output is same as before;
+*v0.3.0x19:
+*         1. column index and weight tables of rk_camera_scale_crop_arm are calculated when zoominfo is changed;
+*v0.3.0x1a:
+*         1. rk_camera_scale_crop_arm split frame to bands, which are scaled on online cpus in parallel;
+*v0.3.0x1b:
+*         1. rk_camera_scale_crop_arm invalidate src rows before read and flush dst written extent after write,
+*            instead of flush whole src and dst buffer;
+*v0.3.0x1c:
+*         1. videobuf mapping is cached by physical address in vbmap, it is mapped in rk_videobuf_prepare
+*            instead of rk_videobuf_queue, and isn't unmapped in rk_videobuf_release;
+*v0.3.0x1d:
+*         1. free rk_camera_work is kept in lock-free stack instead of camera_work_queue with camera_work_lock;
+*         2. vb is given back with VIDEOBUF_ERROR and counted when free rk_camera_work is empty;
+*v0.3.0x1e:
+*         1. rga session is kept in pcdev from first frame until rk_camera_remove_device, instead of each frame,
+*            tiles are still blitted by rga_blit_sync;
+*v0.3.0x1f:
+*         1. ipp failed tile is retried once, and only the tile rows which ipp failed are done by arm;
+*v0.3.0x20:
+*         1. IPP, ARM and RGA scale/crop are all built in, and selected for each stream in rk_camera_set_fmt;
+*         2. rga is only used if scale_crop is 2 when cif probe, ipp and arm cost are both measured before compared;
+*v0.3.0x21:
+*         1. add latency histogram of irq->work, scale and done->dq, export by debugfs rk_cam_cifX_latency;
+*v0.3.0x22:
+*         1. add tracepoints rk_camera:* for irq, videobuf queue/capture, capture process and scale;
+*v0.3.0x23:
+*         1. cif capture into videobuf directly and done it in irq, if it needn't scale, crop or deinterlace;
+*v0.3.0x24:
+*         1. poll wait on done_wq which is woken by every done videobuf and stream off, instead of the first vb in stream;
+*v0.3.0x25:
+*         1. videobuf timestamp is monotonic time taken at the beginning of irq, sequence is dmairq_idx;
+*v0.3.0x26:
+*         1. frame interval and jitter are averaged by every frame, interval is got by VIDIOC_G_PARM, both are in debugfs;
+*v0.3.0x27:
+*         1. measured frame intervals are recorded in hash table which is allocated in probe, and updated by fps timer;
+*v0.3.0x28:
+*         1. skip mdelay and cif reset in rk_camera_setup_format, if cif registers have been this format and sensor isn't inited again;
+*v0.3.0x29:
+*         1. source change notified by sensor is reported by poll POLLPRI and got by control V4L2_CID_RK_CAM_SOURCE_CHANGE;
 */
 
-#define RK_CAM_VERSION_CODE KERNEL_VERSION(0, 3, 0x15)
+#define RK_CAM_VERSION_CODE KERNEL_VERSION(0, 3, 0x29)
 static int version = RK_CAM_VERSION_CODE;
 module_param(version, int, S_IRUGO);
 
+/* Scale/crop engine is selected in rk_camera_set_fmt, 0: Auto(IPP/ARM) 1: IPP 2: RGA(only for RGB, latched in probe) other: ARM */
+static int scale_crop = RK_CAM_SCALE_CROP_DEFAULT;
+module_param(scale_crop, int, S_IRUGO|S_IWUSR);
+
+/* Work mode is latched in rk_camera_setup_format, 0: OneFrame 1: PingPong */
+static int pingpong = CIF_PINGPONG_DEFAULT;
+module_param(pingpong, int, S_IRUGO|S_IWUSR);
+
+/* Capture into videobuf directly if it needn't scale or crop, 0: Disable 1: Enable */
+static int direct_capture = 1;
+module_param(direct_capture, int, S_IRUGO|S_IWUSR);
+
 /* limit to rk29 hardware capabilities */
 #define RK_CAM_BUS_PARAM   (SOCAM_MASTER |\
                 SOCAM_HSYNC_ACTIVE_HIGH |\
@@ -358,7 +462,6 @@ module_param(version, int, S_IRUGO);
 #define RK_CAM_H_MAX        2764
 #define RK_CAM_FRAME_INVAL_INIT      3
 #define RK_CAM_FRAME_INVAL_DC        3          /* ddl@rock-chips.com :  */
-#define RK30_CAM_FRAME_MEASURE       5
 
 
 extern void videobuf_dma_contig_free(struct videobuf_queue *q, struct videobuf_buffer *buf);
@@ -394,18 +497,51 @@ struct rk_camera_work
 	struct videobuf_buffer *vb;
 	struct rk_camera_dev *pcdev;
 	struct work_struct work;
-    struct list_head queue;
+    struct rk_camera_work *next_free;       /* link in pcdev->camera_work_free */
+    ktime_t ts;                             /* time of frame done irq which queue this work */
     unsigned int index;    
 };
+#define RK_CAM_FRMIVAL_BITS     5
+#define RK_CAM_FRMIVAL_NUM      (1<<RK_CAM_FRMIVAL_BITS)
 struct rk_camera_frmivalenum
 {
-    struct v4l2_frmivalenum fival;
-    struct rk_camera_frmivalenum *nxt;
+    struct v4l2_frmivalenum fival;          /* fival.discrete.denominator == 0: entry is free */
 };
+/* measured frame intervals, open addressing hash by (pixel_format, width, height) */
 struct rk_camera_frmivalinfo
 {
     struct soc_camera_device *icd;
-    struct rk_camera_frmivalenum *fival_list;
+    struct rk_camera_frmivalenum fival_tbl[RK_CAM_FRMIVAL_NUM];
+};
+/* column tables of rk_camera_scale_crop_arm, they are only valid for src_w/crop_w/dst_w */
+struct rk_camera_scale_coeff
+{
+    int src_w;
+    int crop_w;
+    int dst_w;
+    int size;
+    unsigned short *x_coeff;        /* xCoeff00 of dst column */
+    unsigned short *y_sx;           /* src column of dst column in Y plane */
+    unsigned short *uv_sx;          /* src byte offset of dst column in interleaved UV plane */
+};
+#define RK_CAM_SCALE_BAND_MAX      4
+struct rk_camera_scale_band
+{
+    struct work_struct work;
+    struct rk_camera_dev *pcdev;
+    int y_start;
+    int y_end;
+};
+/* one frame of rk_camera_scale_crop_arm, it is protected by zoominfo.sem */
+struct rk_camera_scale_job
+{
+    unsigned char *psY,*psUV,*pdY,*pdUV;
+    int srcW,srcH,dstW,dstH;
+    long zoomindstyIntInv;
+    int shift_bits;
+    atomic_t pending;
+    struct completion done;
+    struct rk_camera_scale_band band[RK_CAM_SCALE_BAND_MAX];     /* band[0] is scaled by caller */
 };
 struct rk_camera_zoominfo
 {
@@ -414,6 +550,7 @@ struct rk_camera_zoominfo
     int vir_width;
     int vir_height;
     int zoom_rate;
+    struct rk_camera_scale_coeff coeff;
 };
 #if CAMERA_VIDEOBUF_ARM_ACCESS
 struct rk29_camera_vbinfo
@@ -422,6 +559,15 @@ struct rk29_camera_vbinfo
     void __iomem *vir_addr;
     unsigned int size;
 };
+/* mapping of videobuf is cached by physical address until device is closed */
+#define RK_CAM_VBMAP_NUM        (VIDEO_MAX_FRAME)
+struct rk29_camera_vbmap
+{
+    unsigned int phy_addr;
+    void __iomem *vir_addr;
+    unsigned int size;
+    unsigned long stamp;            /* the oldest unused mapping is replaced first */
+};
 #endif
 struct rk_camera_timer{
 	struct rk_camera_dev *pcdev;
@@ -457,7 +603,27 @@ struct rk_cif_irqinfo
     unsigned long cifirq_abnormal_idx;
 
     unsigned long dmairq_idx;
+
+    unsigned long capture_idx;          /* frames armed by rk_videobuf_capture */
+    unsigned long cifreset_idx;         /* cif soft reset times in rk_videobuf_capture */
+    unsigned long cifreset_abnormal_idx;  /* cifirq_abnormal_idx which has been handled by cif soft reset */
+    ktime_t ts;                         /* monotonic time of the latest irq, taken at the beginning of rk_camera_irq */
+    spinlock_t lock;
+};
+
+/* stages of rk_camera_latency, log2 histogram in us for each */
+#define RK_CAM_LAT_IRQ2WORK     0                                   /* frame done irq -> rk_camera_capture_process */
+#define RK_CAM_LAT_SCALE        1                                   /* scale_crop_cb, + RK_CAM_ENGINE_XXX */
+#define RK_CAM_LAT_WORK2DQ      (RK_CAM_LAT_SCALE+RK_CAM_ENGINE_NUM) /* wake up vb->done -> user find vb done */
+#define RK_CAM_LAT_NUM          (RK_CAM_LAT_WORK2DQ+1)
+#define RK_CAM_LAT_BUCKETS      20                                  /* bucket n is [2^(n-1), 2^n) us, bucket 0 is < 1us */
+struct rk_camera_latency
+{
     spinlock_t lock;
+    unsigned long hist[RK_CAM_LAT_NUM][RK_CAM_LAT_BUCKETS];
+    unsigned long drop_idx;                 /* frames or cif resets dropped because camera_work_free is empty */
+    ktime_t done_ts[VIDEO_MAX_FRAME];       /* time of wake up vb->done, zero after it is counted */
+    struct dentry *dbgfs;
 };
 
 struct rk_camera_dev
@@ -473,7 +639,10 @@ struct rk_camera_dev
 
     unsigned int fps;
     unsigned int last_fps;
-    unsigned long frame_interval;
+    unsigned long frame_interval;       /* us, frame_interval_avg>>4 */
+    unsigned int frame_interval_avg;    /* EWMA of frame interval, us<<4 */
+    unsigned int frame_jitter;          /* EWMA of |frame interval - frame_interval_avg|, us<<4 */
+    ktime_t frame_last;                 /* irq time of the last frame */
     unsigned int pixfmt;
     //for ipp	
     unsigned int vipmem_phybase;
@@ -483,6 +652,9 @@ struct rk_camera_dev
 #if CAMERA_VIDEOBUF_ARM_ACCESS    
     struct rk29_camera_vbinfo *vbinfo;
     unsigned int vbinfo_count;
+    struct rk29_camera_vbmap vbmap[RK_CAM_VBMAP_NUM];
+    unsigned long vbmap_stamp;
+    struct mutex vbmap_lock;            /* protect vbmap and vbinfo */
 #endif    
     int host_width;
     int host_height;
@@ -494,6 +666,7 @@ struct rk_camera_dev
 
     struct rk_cif_crop cropinfo;
     struct rk_cif_irqinfo irqinfo;
+    struct rk_camera_latency latency;
 
     struct rk29camera_platform_data *pdata;
     struct resource		*res;
@@ -502,23 +675,39 @@ struct rk_camera_dev
 
     spinlock_t		lock;
 
-    struct videobuf_buffer	*active;
+    struct videobuf_buffer	*active[2];      /* videobuf in FRM0 and FRM1, FRM1 is only used in pingpong mode */
+    unsigned int work_mode;                 /* MODE_ONEFRAME or MODE_PINGPONG */
+    unsigned int frame_next;                /* frame which will be completed next in pingpong mode */
+    unsigned int frame_direct;              /* bit n is set if FRMn is captured into videobuf directly */
     struct rk_camera_reg reginfo_suspend;
     struct workqueue_struct *camera_wq;
+    struct workqueue_struct *scale_wq;
+#if RK_CAM_SCALE_CROP_RGA_EN
+    rga_session rga_session;
+    bool rga_session_en;
+    bool rga_en;                                /* scale_crop is 2 in probe, RGB formats are provided */
+#endif
+    struct rk_camera_scale_job scale_job;
+    unsigned int scale_engine;                  /* RK_CAM_ENGINE_XXX of scale_crop_cb */
+    unsigned int scale_probe;                   /* RK_CAM_ENGINE_XXX whose cost is measured on probe frame, NUM: none */
+    unsigned int scale_frames;                  /* frames processed by scale_crop_cb in this stream */
+    unsigned int scale_cost[RK_CAM_ENGINE_NUM]; /* average scale time per pixel(ns*16) of each engine, 0: unknown */
+    int crop_align;
     struct rk_camera_work *camera_work;
-    struct list_head camera_work_queue;
-    spinlock_t camera_work_lock;
+    struct rk_camera_work *camera_work_free;    /* lock-free stack, see rk_camera_work_push */
     unsigned int camera_work_count;
     struct rk_camera_timer fps_timer;
     struct rk_camera_work camera_reinit_work;
     int icd_init;
+    struct soc_camera_device *fmt_icd;  /* icd which cif format is set up for last, NULL if its sensor is inited/removed since then */
     rk29_camera_sensor_cb_s icd_cb;
     struct rk_camera_frmivalinfo icd_frmival[2];
     bool timer_get_fps;
     unsigned int reinit_times; 
     struct videobuf_queue *video_vq;
+    wait_queue_head_t done_wq;          /* woken whenever a videobuf of video_vq is given back, for poll */
+    unsigned int src_change;            /* RK_CAM_SRC_CH_* notified by sensor, cleared by reading V4L2_CID_RK_CAM_SOURCE_CHANGE or VIDIOC_S_FMT, protected by lock */
     atomic_t stop_cif;
-    struct timeval first_tv;
     
     int chip_id;
 };
@@ -533,6 +722,16 @@ static const struct v4l2_queryctrl rk_camera_controls[] =
         .maximum	= 300,
         .step		= 5,
         .default_value = 100,
+    },
+    {
+        .id		= V4L2_CID_RK_CAM_SOURCE_CHANGE,
+        .type		= V4L2_CTRL_TYPE_INTEGER,
+        .name		= "Source Change",
+        .minimum	= 0,
+        .maximum	= RK_CAM_SRC_CH_RESOLUTION,
+        .step		= 1,
+        .default_value = 0,
+        .flags      = V4L2_CTRL_FLAG_READ_ONLY,
     }
 };
 
@@ -542,12 +741,163 @@ static DEFINE_MUTEX(camera_lock);
 static const char *rk_cam_driver_description = "RK_Camera";
 
 static int rk_camera_s_stream(struct soc_camera_device *icd, int enable);
+
+/*
+ * Free rk_camera_work is pushed by workqueue in any cpu and only popped in rk_camera_irq,
+ * a work can't be pushed again before it is popped, so single consumer cmpxchg stack hasn't ABA problem.
+ */
+static inline void rk_camera_work_push(struct rk_camera_dev *pcdev, struct rk_camera_work *wk)
+{
+    struct rk_camera_work *first;
+
+    do {
+        first = ACCESS_ONCE(pcdev->camera_work_free);
+        wk->next_free = first;
+    } while (cmpxchg(&pcdev->camera_work_free, first, wk) != first);
+}
+/* dropped frame or cif reset is only counted here, under latency.lock which debugfs reads it with */
+static inline unsigned long rk_camera_latency_drop(struct rk_camera_dev *pcdev)
+{
+    unsigned long flags,drop_idx;
+
+    spin_lock_irqsave(&pcdev->latency.lock,flags);
+    drop_idx = ++pcdev->latency.drop_idx;
+    spin_unlock_irqrestore(&pcdev->latency.lock,flags);
+    return drop_idx;
+}
+/* Locking: Caller holds pcdev->lock, it is the only consumer */
+static inline struct rk_camera_work *rk_camera_work_pop(struct rk_camera_dev *pcdev)
+{
+    struct rk_camera_work *first,*next;
+
+    do {
+        first = ACCESS_ONCE(pcdev->camera_work_free);
+        if (first == NULL)
+            return NULL;
+        next = first->next_free;
+    } while (cmpxchg(&pcdev->camera_work_free, first, next) != first);
+
+    first->next_free = NULL;
+    return first;
+}
+/*
+ * Latency of each stage of a frame is counted in pcdev->latency and exported by debugfs rk_cam_cifX_latency.
+ */
+static void rk_camera_latency_add(struct rk_camera_dev *pcdev, int stage, ktime_t start, ktime_t end)
+{
+    s64 us = ktime_us_delta(end, start);
+    unsigned long flags;
+    int bucket;
+
+    if (us <= 0) {
+        bucket = 0;
+    } else if (us >= (1<<(RK_CAM_LAT_BUCKETS-1))) {
+        bucket = RK_CAM_LAT_BUCKETS-1;
+    } else {
+        bucket = fls((unsigned int)us);
+    }
+    
+    spin_lock_irqsave(&pcdev->latency.lock,flags);
+    pcdev->latency.hist[stage][bucket]++;
+    spin_unlock_irqrestore(&pcdev->latency.lock,flags);
+}
+static inline void rk_camera_latency_done(struct rk_camera_dev *pcdev, struct videobuf_buffer *vb)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&pcdev->latency.lock,flags);
+    pcdev->latency.done_ts[vb->i] = ktime_get();
+    spin_unlock_irqrestore(&pcdev->latency.lock,flags);
+}
+/* vb is found done by user, it is the last time which host can see before dqbuf */
+static void rk_camera_latency_dq(struct rk_camera_dev *pcdev, struct videobuf_buffer *vb)
+{
+    unsigned long flags;
+    ktime_t done;
+
+    spin_lock_irqsave(&pcdev->latency.lock,flags);
+    done = pcdev->latency.done_ts[vb->i];
+    pcdev->latency.done_ts[vb->i] = ktime_set(0,0);
+    spin_unlock_irqrestore(&pcdev->latency.lock,flags);
+
+    if (done.tv64)
+        rk_camera_latency_add(pcdev, RK_CAM_LAT_WORK2DQ, done, ktime_get());
+}
+/*
+ * vb may be done out of order by workqueue, so poll waits on done_wq instead of the first vb in stream.
+ * It is only a wakeup change: done_wq is per cif, which serves one icd(vb_vidq) at a time.
+ * done_wq is woken by stream off too, poll returns POLLERR if stream is empty or stopped.
+ */
+static inline void rk_camera_vb_done(struct rk_camera_dev *pcdev, struct videobuf_buffer *vb)
+{
+    rk_camera_latency_done(pcdev, vb);
+    wake_up(&vb->done);
+    wake_up(&pcdev->done_wq);
+}
+static void rk_camera_latency_reset(struct rk_camera_dev *pcdev)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&pcdev->latency.lock,flags);
+    memset(pcdev->latency.hist, 0x00, sizeof(pcdev->latency.hist));
+    memset(pcdev->latency.done_ts, 0x00, sizeof(pcdev->latency.done_ts));
+    pcdev->latency.drop_idx = 0;
+    spin_unlock_irqrestore(&pcdev->latency.lock,flags);
+}
+static int rk_camera_latency_show(struct seq_file *s, void *v)
+{
+    static const char *stage_name[RK_CAM_LAT_NUM] = {
+        "irq->work", "scale(arm)", "scale(ipp)", "scale(rga)", "scale(pp)", "done->dq"
+    };
+    struct rk_camera_dev *pcdev = s->private;
+    unsigned long flags;
+    int i,j;
+
+    seq_printf(s, "%-16s", "us");
+    for (j=0; j<RK_CAM_LAT_NUM; j++)
+        seq_printf(s, "%12s", stage_name[j]);
+    seq_printf(s, "\n");
+
+    spin_lock_irqsave(&pcdev->latency.lock,flags);
+    for (i=0; i<RK_CAM_LAT_BUCKETS; i++) {
+        if (i == 0) {
+            seq_printf(s, "%-16s", "0-1");
+        } else if (i == RK_CAM_LAT_BUCKETS-1) {
+            seq_printf(s, "%7d-%-8s", 1<<(i-1), "inf");
+        } else {
+            seq_printf(s, "%7d-%-8d", 1<<(i-1), 1<<i);
+        }
+        for (j=0; j<RK_CAM_LAT_NUM; j++)
+            seq_printf(s, "%12lu", pcdev->latency.hist[j][i]);
+        seq_printf(s, "\n");
+    }
+    seq_printf(s, "dropped frames/cif resets: %lu, camera work pool: %d\n",
+                pcdev->latency.drop_idx, pcdev->camera_work_count);
+    seq_printf(s, "frame interval: %u us, jitter: %u us\n",
+                pcdev->frame_interval_avg>>4, pcdev->frame_jitter>>4);
+    spin_unlock_irqrestore(&pcdev->latency.lock,flags);
+
+    return 0;
+}
+static int rk_camera_latency_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, rk_camera_latency_show, inode->i_private);
+}
+static const struct file_operations rk_camera_latency_fops = {
+    .owner      = THIS_MODULE,
+    .open       = rk_camera_latency_open,
+    .read       = seq_read,
+    .llseek     = seq_lseek,
+    .release    = single_release,
+};
 static void rk_camera_capture_process(struct work_struct *work);
 static int rk_camera_scale_crop_arm(struct work_struct *work);
+static int rk_camera_scale_crop_arm_rows(struct work_struct *work, int y_start, int y_end);
 
 static void rk_camera_cif_reset(struct rk_camera_dev *pcdev, int only_rst)
 {
     int ctrl_reg,inten_reg,crop_reg,set_size_reg,for_reg,vir_line_width_reg,scl_reg,y_reg,uv_reg;
+    int y1_reg,uv1_reg,frm_status_reg;
     enum cru_soft_reset cif_reset_index = SOFT_RST_CIF0;
 
     if (IS_CIF0() == false) { 
@@ -576,6 +926,9 @@ static void rk_camera_cif_reset(struct rk_camera_dev *pcdev, int only_rst)
     	scl_reg = read_cif_reg(pcdev->base,CIF_CIF_SCL_CTRL);
     	y_reg = read_cif_reg(pcdev->base, CIF_CIF_FRM0_ADDR_Y);
     	uv_reg = read_cif_reg(pcdev->base, CIF_CIF_FRM0_ADDR_UV);
+    	y1_reg = read_cif_reg(pcdev->base, CIF_CIF_FRM1_ADDR_Y);
+    	uv1_reg = read_cif_reg(pcdev->base, CIF_CIF_FRM1_ADDR_UV);
+    	frm_status_reg = read_cif_reg(pcdev->base, CIF_CIF_FRAME_STATUS);
     	
     	cru_set_soft_reset(cif_reset_index, true);
     	udelay(5);
@@ -590,6 +943,11 @@ static void rk_camera_cif_reset(struct rk_camera_dev *pcdev, int only_rst)
 	    write_cif_reg(pcdev->base,CIF_CIF_SCL_CTRL,scl_reg);
 	    write_cif_reg(pcdev->base,CIF_CIF_FRM0_ADDR_Y,y_reg);       /*ddl@rock-chips.com v0.3.0x13*/
 	    write_cif_reg(pcdev->base,CIF_CIF_FRM0_ADDR_UV,uv_reg);
+	    if (CAM_PINGPONG_IS_EN()) {
+	        write_cif_reg(pcdev->base,CIF_CIF_FRM1_ADDR_Y,y1_reg);
+	        write_cif_reg(pcdev->base,CIF_CIF_FRM1_ADDR_UV,uv1_reg);
+	        write_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS,frm_status_reg);
+	    }
     }
     return;
 }
@@ -652,16 +1010,17 @@ static int rk_videobuf_setup(struct videobuf_queue *vq, unsigned int *count,
 				RKCAMERA_TR("kmalloc failed\n");
 				BUG();
 			}
-            INIT_LIST_HEAD(&pcdev->camera_work_queue);
+            pcdev->camera_work_free = NULL;
 
             for (i=0; i<(*count); i++) {
                 wk->index = i;                
-                list_add_tail(&wk->queue, &pcdev->camera_work_queue);
+                rk_camera_work_push(pcdev, wk);
                 wk++; 
             }
 			pcdev->camera_work_count = (*count);
 		}
 #if CAMERA_VIDEOBUF_ARM_ACCESS
+        mutex_lock(&pcdev->vbmap_lock);
         if (pcdev->vbinfo && (pcdev->vbinfo_count != *count)) {
             kfree(pcdev->vbinfo);
             pcdev->vbinfo = NULL;
@@ -677,6 +1036,7 @@ static int rk_videobuf_setup(struct videobuf_queue *vq, unsigned int *count,
             memset(pcdev->vbinfo,0,sizeof(struct rk29_camera_vbinfo)*(*count));
 			pcdev->vbinfo_count = *count;
         }
+        mutex_unlock(&pcdev->vbmap_lock);
 #endif        
 	}
     pcdev->video_vq = vq;
@@ -707,9 +1067,109 @@ static void rk_videobuf_free(struct videobuf_queue *vq, struct rk_camera_buffer
     buf->vb.state = VIDEOBUF_NEEDS_INIT;
 	return;
 }
+#if CAMERA_VIDEOBUF_ARM_ACCESS
+/* Locking: Caller holds pcdev->vbmap_lock */
+static bool rk_camera_vbmap_busy(struct rk_camera_dev *pcdev, struct rk29_camera_vbmap *vbmap)
+{
+    unsigned int i;
+
+    for (i=0; i<pcdev->vbinfo_count; i++) {
+        if (pcdev->vbinfo[i].vir_addr == vbmap->vir_addr)
+            return true;
+    }
+    return false;
+}
+/* Locking: Caller holds pcdev->vbmap_lock */
+static void rk_camera_vbmap_put(struct rk29_camera_vbmap *vbmap)
+{
+    if (vbmap->vir_addr) {
+        iounmap(vbmap->vir_addr);
+        release_mem_region(vbmap->phy_addr, vbmap->size);
+    }
+    memset(vbmap, 0x00, sizeof(struct rk29_camera_vbmap));
+}
+/*
+ * Fill pcdev->vbinfo[vb->i] from vbmap, videobuf is only mapped when it isn't in vbmap,
+ * it is called in process context, so request_mem_region and ioremap_cached aren't under q->irqlock.
+ */
+static int rk_camera_vbmap_get(struct rk_camera_dev *pcdev, struct videobuf_buffer *vb)
+{
+    struct rk29_camera_vbinfo *vb_info;
+    struct rk29_camera_vbmap *vbmap,*hit = NULL,*free = NULL;
+    unsigned int i;
+    int ret = 0;
+
+    if ((pcdev->vbinfo == NULL) || (vb->i >= pcdev->vbinfo_count))
+        return 0;
+
+    mutex_lock(&pcdev->vbmap_lock);
+    vb_info = pcdev->vbinfo + vb->i;
+    memset(vb_info, 0x00, sizeof(struct rk29_camera_vbinfo));
+
+    for (i=0; i<RK_CAM_VBMAP_NUM; i++) {
+        vbmap = &pcdev->vbmap[i];
+        if ((vbmap->vir_addr) && (vbmap->phy_addr == vb->boff) && (vbmap->size == vb->bsize)) {
+            hit = vbmap;
+            break;
+        }
+    }
+
+    if (hit == NULL) {
+        for (i=0; i<RK_CAM_VBMAP_NUM; i++) {
+            vbmap = &pcdev->vbmap[i];
+            /* mapping which overlap this videobuf is stale, videobuf memory has been reallocated */
+            if (vbmap->vir_addr && (vbmap->phy_addr < vb->boff + vb->bsize) && (vb->boff < vbmap->phy_addr + vbmap->size)
+                && (rk_camera_vbmap_busy(pcdev,vbmap) == false)) {
+                rk_camera_vbmap_put(vbmap);
+            }
+            if ((vbmap->vir_addr == NULL) && (free == NULL))
+                free = vbmap;
+        }
+
+        if (free == NULL) {
+            for (i=0; i<RK_CAM_VBMAP_NUM; i++) {
+                vbmap = &pcdev->vbmap[i];
+                if (((free == NULL) || (vbmap->stamp < free->stamp)) && (rk_camera_vbmap_busy(pcdev,vbmap) == false))
+                    free = vbmap;
+            }
+            if (free)
+                rk_camera_vbmap_put(free);
+        }
+
+        if (free && request_mem_region(vb->boff,vb->bsize,"rk_camera_vb")) {
+            free->vir_addr = ioremap_cached(vb->boff,vb->bsize);
+            if (free->vir_addr) {
+                free->phy_addr = vb->boff;
+                free->size = vb->bsize;
+                hit = free;
+            } else {
+                release_mem_region(vb->boff,vb->bsize);
+            }
+        }
+
+        if (hit == NULL) {
+            RKCAMERA_TR("ioremap videobuf %d failed\n",vb->i);
+            ret = -ENOMEM;
+            goto end;
+        }
+    }
+
+    hit->stamp = ++pcdev->vbmap_stamp;
+    vb_info->phy_addr = hit->phy_addr;
+    vb_info->vir_addr = hit->vir_addr;
+    vb_info->size = hit->size;
+end:
+    mutex_unlock(&pcdev->vbmap_lock);
+    return ret;
+}
+#endif
 static int rk_videobuf_prepare(struct videobuf_queue *vq, struct videobuf_buffer *vb, enum v4l2_field field)
 {
     struct soc_camera_device *icd = vq->priv_data;
+#if CAMERA_VIDEOBUF_ARM_ACCESS
+    struct soc_camera_host *ici = to_soc_camera_host(icd->dev.parent);
+    struct rk_camera_dev *pcdev = ici->priv;
+#endif
     struct rk_camera_buffer *buf;
     int ret;
     int bytes_per_line = soc_mbus_bytes_per_line(icd->user_width,
@@ -751,6 +1211,11 @@ static int rk_videobuf_prepare(struct videobuf_queue *vq, struct videobuf_buffer
         }
         vb->state = VIDEOBUF_PREPARED;
     }
+#if CAMERA_VIDEOBUF_ARM_ACCESS
+    ret = rk_camera_vbmap_get(pcdev, vb);
+    if (ret)
+        goto fail;
+#endif
     
     return 0;
 fail:
@@ -759,13 +1224,17 @@ out:
     return ret;
 }
 
-static inline void rk_videobuf_capture(struct videobuf_buffer *vb,struct rk_camera_dev *rk_pcdev)
+static inline void rk_videobuf_capture(struct videobuf_buffer *vb,struct rk_camera_dev *rk_pcdev, int frame)
 {
-	unsigned int y_addr,uv_addr;
+	unsigned int y_addr,uv_addr,frm_status,dma_end;
 	struct rk_camera_dev *pcdev = rk_pcdev;
 
     if (vb) {
-		if (CAM_WORKQUEUE_IS_EN()) {
+        pcdev->irqinfo.capture_idx++;
+        trace_rk_camera_buf_capture(pcdev->hostid, vb->i, vb->state, pcdev->irqinfo.capture_idx, pcdev->irqinfo.dmairq_idx);
+        /* direct is latched for the frame, zoom may be changed before it is done */
+        if (CAM_WORKQUEUE_IS_EN() && !CAM_DIRECT_IS_EN()) {
+            pcdev->frame_direct &= ~(0x01<<frame);
 			y_addr = pcdev->vipmem_phybase + vb->i*pcdev->vipmem_bsize;
 			uv_addr = y_addr + pcdev->zoominfo.vir_width*pcdev->zoominfo.vir_height;
 			if (y_addr > (pcdev->vipmem_phybase + pcdev->vipmem_size - pcdev->vipmem_bsize)) {
@@ -774,18 +1243,62 @@ static inline void rk_videobuf_capture(struct videobuf_buffer *vb,struct rk_came
 				BUG();
 			}
 		} else {
+            pcdev->frame_direct |= (0x01<<frame);
 			y_addr = vb->boff;
 			uv_addr = y_addr + vb->width * vb->height;
 		}
+
+        if (CAM_PINGPONG_IS_EN()) {
+            /* only the frame which is given a new videobuf is released to cif */
+            if (frame == 0) {
+                write_cif_reg(pcdev->base,CIF_CIF_FRM0_ADDR_Y, y_addr);
+                write_cif_reg(pcdev->base,CIF_CIF_FRM0_ADDR_UV, uv_addr);
+            } else {
+                write_cif_reg(pcdev->base,CIF_CIF_FRM1_ADDR_Y, y_addr);
+                write_cif_reg(pcdev->base,CIF_CIF_FRM1_ADDR_UV, uv_addr);
+            }
+            /*
+            * FRAME_STATUS isn't write 1 clear, cif may set the other frame's bit between read and write,
+            * then it is lost. dma irq is pending again in this case, so the bit is set back.
+            */
+            dma_end = read_cif_reg(pcdev->base,CIF_CIF_INTSTAT) & 0x01;
+            frm_status = read_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS);
+            write_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS, frm_status & ~(0x01<<frame));
+            if (!dma_end && (read_cif_reg(pcdev->base,CIF_CIF_INTSTAT) & 0x01)) {
+                frm_status = read_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS);
+                write_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS, frm_status | (0x01<<(frame^0x01)));
+            }
+        } else {
 #if defined(CONFIG_ARCH_RK3188)
-		rk_camera_cif_reset(pcdev,false);
+            /* reset cif only when the last cif irq is abnormal */
+            if (pcdev->irqinfo.cifirq_abnormal_idx != pcdev->irqinfo.cifreset_abnormal_idx) {
+                pcdev->irqinfo.cifreset_abnormal_idx = pcdev->irqinfo.cifirq_abnormal_idx;
+                pcdev->irqinfo.cifreset_idx++;
+    		    rk_camera_cif_reset(pcdev,false);
+            }
 #endif
-        write_cif_reg(pcdev->base,CIF_CIF_FRM0_ADDR_Y, y_addr);
-        write_cif_reg(pcdev->base,CIF_CIF_FRM0_ADDR_UV, uv_addr);
-        write_cif_reg(pcdev->base,CIF_CIF_FRM1_ADDR_Y, y_addr);
-        write_cif_reg(pcdev->base,CIF_CIF_FRM1_ADDR_UV, uv_addr);
-        write_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS,  0x00000002);//frame1 has been ready to receive data,frame 2 is not used
+            write_cif_reg(pcdev->base,CIF_CIF_FRM0_ADDR_Y, y_addr);
+            write_cif_reg(pcdev->base,CIF_CIF_FRM0_ADDR_UV, uv_addr);
+            write_cif_reg(pcdev->base,CIF_CIF_FRM1_ADDR_Y, y_addr);
+            write_cif_reg(pcdev->base,CIF_CIF_FRM1_ADDR_UV, uv_addr);
+            write_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS,  0x00000002);//frame1 has been ready to receive data,frame 2 is not used
+        }
+    }
+}
+/*
+ * Locking: Caller holds pcdev->lock
+ * The videobuf which is being captured is keeped in capture list until frame end,
+ * so the videobuf in the other frame must be skipped in pingpong mode.
+ */
+static struct videobuf_buffer *rk_camera_capture_next(struct rk_camera_dev *pcdev)
+{
+    struct videobuf_buffer *vb;
+
+    list_for_each_entry(vb, &pcdev->capture, queue) {
+        if ((vb != pcdev->active[0]) && (vb != pcdev->active[1]))
+            return vb;
     }
+    return NULL;
 }
 /* Locking: Caller holds q->irqlock */
 static void rk_videobuf_queue(struct videobuf_queue *vq,
@@ -794,13 +1307,11 @@ static void rk_videobuf_queue(struct videobuf_queue *vq,
     struct soc_camera_device *icd = vq->priv_data;
     struct soc_camera_host *ici = to_soc_camera_host(icd->dev.parent);
     struct rk_camera_dev *pcdev = ici->priv;
-#if CAMERA_VIDEOBUF_ARM_ACCESS    
-    struct rk29_camera_vbinfo *vb_info;
-#endif
 
     dev_dbg(&icd->dev, "%s (vb=0x%p) 0x%08lx %zd\n", __func__,
             vb, vb->baddr, vb->bsize);
 
+    trace_rk_camera_buf_queue(pcdev->hostid, vb->i, vb->state, pcdev->irqinfo.capture_idx, pcdev->irqinfo.dmairq_idx);
     vb->state = VIDEOBUF_QUEUED;
 	if (list_empty(&pcdev->capture)) {
 		list_add_tail(&vb->queue, &pcdev->capture);
@@ -810,40 +1321,19 @@ static void rk_videobuf_queue(struct videobuf_queue *vq,
 		else
 			BUG();    /* ddl@rock-chips.com : The same videobuffer queue again */
 	}
-#if CAMERA_VIDEOBUF_ARM_ACCESS
-    if (pcdev->vbinfo) {
-        vb_info = pcdev->vbinfo+vb->i;
-        if ((vb_info->phy_addr != vb->boff) || (vb_info->size != vb->bsize)) {
-            if (vb_info->vir_addr) {
-                iounmap(vb_info->vir_addr);
-                release_mem_region(vb_info->phy_addr, vb_info->size);
-                vb_info->vir_addr = NULL;
-                vb_info->phy_addr = 0x00;
-                vb_info->size = 0x00;
-            }
-
-            if (request_mem_region(vb->boff,vb->bsize,"rk_camera_vb")) {
-                vb_info->vir_addr = ioremap_cached(vb->boff,vb->bsize); 
-            }
-            
-            if (vb_info->vir_addr) {
-                vb_info->size = vb->bsize;
-                vb_info->phy_addr = vb->boff;
-            } else {
-                RKCAMERA_TR("ioremap videobuf %d failed\n",vb->i);
-            }
-        }
-    }
-#endif    
-    if (!pcdev->active) {
-        pcdev->active = vb;
-        rk_videobuf_capture(vb,pcdev);
+    /* pcdev->vbinfo[vb->i] has been mapped in rk_videobuf_prepare */
+    if (!pcdev->active[0]) {
+        pcdev->active[0] = vb;
+        rk_videobuf_capture(vb,pcdev,0);
         if (atomic_read(&pcdev->stop_cif) == false) {           /*ddl@rock-chips.com v0.3.0x13*/
             write_cif_reg(pcdev->base,CIF_CIF_CTRL, (read_cif_reg(pcdev->base,CIF_CIF_CTRL) | ENABLE_CAPTURE));
         }       
+    } else if (CAM_PINGPONG_IS_EN() && !pcdev->active[1]) {
+        pcdev->active[1] = vb;
+        rk_videobuf_capture(vb,pcdev,1);
     }
 }
-#if (CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_IPP)
+#if RK_CAM_SCALE_CROP_SEL
 static int rk_pixfmt2ippfmt(unsigned int pixfmt, int *ippfmt)
 {
 	switch (pixfmt)
@@ -869,7 +1359,7 @@ rk_pixfmt2ippfmt_err:
 	return -1;
 }
 #endif
-#if (CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_RGA)
+#if RK_CAM_SCALE_CROP_RGA_EN
 static int rk_pixfmt2rgafmt(unsigned int pixfmt, int *ippfmt)
 {
 	switch (pixfmt)
@@ -932,6 +1422,7 @@ static int rk_camera_scale_crop_pp(struct work_struct *work){
 	init.dstWidth	= init.dstHStride = pcdev->icd->user_width;
 	init.dstHeight	= init.dstVStride = pcdev->icd->user_height;
 
+	trace_rk_camera_scale_start(pcdev->hostid, vb->i, RK_CAM_ENGINE_PP, init.srcWidth, init.srcHeight, init.dstWidth, init.dstHeight);
 	printk("srcWidth = %d,srcHeight = %d,dstWidth = %d,dstHeight = %d\n",init.srcWidth,init.srcHeight,init.dstWidth,init.dstHeight);
 	#if 0
 	ret = ppOpInit(&hnd, &init);
@@ -943,32 +1434,80 @@ static int rk_camera_scale_crop_pp(struct work_struct *work){
 		printk("can not create ppOp handle\n");
 	}
 	#endif
+	trace_rk_camera_scale_end(pcdev->hostid, vb->i, RK_CAM_ENGINE_PP, ret);
 	return ret;
 }
 #endif
-#if (CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_RGA)
+#if RK_CAM_SCALE_CROP_RGA_EN
 extern rga_service_info rga_service;
 extern int rga_blit_sync(rga_session *session, struct rga_req *req);
 extern	 void rga_service_session_clear(rga_session *session);
+/* 
+* rga session is kept in pcdev from first frame until rk_camera_remove_device, 
+* caller of these functions is serialized by zoominfo.sem or camera_lock.
+* Tiles are blitted one by one by rga_blit_sync, rga driver doesn't export rga_blit_async.
+*/
+static void rk_camera_rga_session_init(struct rk_camera_dev *pcdev)
+{
+	rga_session *session = &pcdev->rga_session;
+
+	if (pcdev->rga_session_en == true)
+		return;
+
+	session->pid = current->pid;
+	INIT_LIST_HEAD(&session->waiting);
+	INIT_LIST_HEAD(&session->running);
+	INIT_LIST_HEAD(&session->list_session);
+	init_waitqueue_head(&session->wait);
+	atomic_set(&session->task_running, 0);
+	atomic_set(&session->num_done, 0);
+	mutex_lock(&rga_service.lock);
+	list_add_tail(&session->list_session, &rga_service.session);
+	mutex_unlock(&rga_service.lock);
+	pcdev->rga_session_en = true;
+}
+static void rk_camera_rga_session_deinit(struct rk_camera_dev *pcdev)
+{
+	if (pcdev->rga_session_en == false)
+		return;
+
+	mutex_lock(&rga_service.lock);
+	list_del(&pcdev->rga_session.list_session);
+	rga_service_session_clear(&pcdev->rga_session);
+	mutex_unlock(&rga_service.lock);
+	pcdev->rga_session_en = false;
+}
+static void rk_camera_rga_req_tile(struct rk_camera_dev *pcdev, struct rga_req *req, struct videobuf_buffer *vb,
+                                        int vipdata_base, int scale_times, int w, int h)
+{
+	req->src.yrgb_addr = vipdata_base;
+	req->src.uv_addr =vipdata_base + pcdev->zoominfo.vir_width*pcdev->zoominfo.vir_height;
+	req->src.x_offset = pcdev->zoominfo.a.c.left+w*pcdev->zoominfo.a.c.width/scale_times;
+	req->src.y_offset = pcdev->zoominfo.a.c.top+h*pcdev->zoominfo.a.c.height/scale_times;
+	req->dst.x_offset =  pcdev->icd->user_width*w/scale_times;
+	req->dst.y_offset = pcdev->icd->user_height*h/scale_times;
+	req->dst.yrgb_addr = vb->boff ;
+}
 static int rk_camera_scale_crop_rga(struct work_struct *work){
 	struct rk_camera_work *camera_work = container_of(work, struct rk_camera_work, work);
 	struct videobuf_buffer *vb = camera_work->vb;
 	struct rk_camera_dev *pcdev = camera_work->pcdev;
+	rga_session *session = &pcdev->rga_session;
 	int vipdata_base;
 	unsigned long int flags;
 	int scale_times,w,h;
-	int src_y_offset;
 	struct rga_req req;
-	rga_session session;
 	int rga_times = 3;
 	const struct soc_mbus_pixelfmt *fmt;
 	int ret = 0;
 	fmt = soc_mbus_get_fmtdesc(pcdev->icd->current_fmt->code);
 	vipdata_base = pcdev->vipmem_phybase + vb->i*pcdev->vipmem_bsize;
+	trace_rk_camera_scale_start(pcdev->hostid, vb->i, RK_CAM_ENGINE_RGA, pcdev->zoominfo.a.c.width, pcdev->zoominfo.a.c.height,
+	                            pcdev->icd->user_width, pcdev->icd->user_height);
 	if((pcdev->icd->current_fmt->host_fmt->fourcc != V4L2_PIX_FMT_RGB565)
 		&& (pcdev->icd->current_fmt->host_fmt->fourcc != V4L2_PIX_FMT_RGB24)){
 		RKCAMERA_TR("RGA not support this format !\n");
-		goto do_ipp_err;
+		goto rk_camera_scale_crop_rga_end;
 		}
 	if ((pcdev->icd->user_width > 0x800) || (pcdev->icd->user_height > 0x800)) {
 		scale_times = MAX((pcdev->icd->user_width/0x800),(pcdev->icd->user_height/0x800));		  
@@ -976,15 +1515,7 @@ static int rk_camera_scale_crop_rga(struct work_struct *work){
 	} else {
 		scale_times = 1;
 	}
-	session.pid = current->pid;
-	INIT_LIST_HEAD(&session.waiting);
-	INIT_LIST_HEAD(&session.running);
-	INIT_LIST_HEAD(&session.list_session);
-	init_waitqueue_head(&session.wait);
-	/* no need to protect */
-	list_add_tail(&session.list_session, &rga_service.session);
-	atomic_set(&session.task_running, 0);
-	atomic_set(&session.num_done, 0);
+	rk_camera_rga_session_init(pcdev);
 	
 	memset(&req,0,sizeof(struct rga_req));
 	req.src.act_w = pcdev->zoominfo.a.c.width/scale_times;
@@ -1024,20 +1555,13 @@ static int rk_camera_scale_crop_rga(struct work_struct *work){
 	for (h=0; h<scale_times; h++) {
 		for (w=0; w<scale_times; w++) {
 			rga_times = 3;
-	
-			req.src.yrgb_addr = vipdata_base;
-			req.src.uv_addr =vipdata_base + pcdev->zoominfo.vir_width*pcdev->zoominfo.vir_height;;
-			req.src.x_offset = pcdev->zoominfo.a.c.left+w*pcdev->zoominfo.a.c.width/scale_times;
-			req.src.y_offset = pcdev->zoominfo.a.c.top+h*pcdev->zoominfo.a.c.height/scale_times;
-			req.dst.x_offset =  pcdev->icd->user_width*w/scale_times;
-			req.dst.y_offset = pcdev->icd->user_height*h/scale_times;
-			req.dst.yrgb_addr = vb->boff ;
+			rk_camera_rga_req_tile(pcdev, &req, vb, vipdata_base, scale_times, w, h);
 		//	RKCAMERA_TR("src.act_w = %d , src.act_h  = %d! vir_w = %d , vir_h = %d,off_x = %d,off_y = %d\n",req.src.act_w,req.src.act_h ,req.src.vir_w,req.src.vir_h,req.src.x_offset,req.src.y_offset);
 		//	RKCAMERA_TR("dst.act_w = %d , dst.act_h  = %d! vir_w = %d , vir_h = %d,off_x = %d,off_y = %d\n",req.dst.act_w,req.dst.act_h ,req.dst.vir_w,req.dst.vir_h,req.dst.x_offset,req.dst.y_offset);
 		//	RKCAMERA_TR("req.src.yrgb_addr = 0x%x,req.dst.yrgb_addr = 0x%x\n",req.src.yrgb_addr,req.dst.yrgb_addr);
 
 			while(rga_times-- > 0) {
-				if (rga_blit_sync(&session, &req)){
+				if (rga_blit_sync(session, &req)){
 					RKCAMERA_TR("rga do erro,do again,rga_times = %d!\n",rga_times);
 				 } else {
 					break;
@@ -1048,28 +1572,20 @@ static int rk_camera_scale_crop_rga(struct work_struct *work){
 				spin_lock_irqsave(&pcdev->lock, flags);
 				vb->state = VIDEOBUF_NEEDS_INIT;
 				spin_unlock_irqrestore(&pcdev->lock, flags);
-				mutex_lock(&rga_service.lock);
-				list_del(&session.list_session);
-				rga_service_session_clear(&session);
-				mutex_unlock(&rga_service.lock);
-				goto session_done;
-			}
+				ret = -EIO;
+				goto rk_camera_scale_crop_rga_end;
 			}
+		}
 	}
-	session_done:
-	mutex_lock(&rga_service.lock);
-	list_del(&session.list_session);
-	rga_service_session_clear(&session);
-	mutex_unlock(&rga_service.lock);
-
-	do_ipp_err:
 
+rk_camera_scale_crop_rga_end:
+		trace_rk_camera_scale_end(pcdev->hostid, vb->i, RK_CAM_ENGINE_RGA, ret);
 		return ret;
 	
 }
 
 #endif
-#if (CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_IPP)
+#if RK_CAM_SCALE_CROP_SEL
 
 static int rk_camera_scale_crop_ipp(struct work_struct *work)
 {
@@ -1082,8 +1598,12 @@ static int rk_camera_scale_crop_ipp(struct work_struct *work)
 	struct rk29_ipp_req ipp_req;
 	int src_y_offset,src_uv_offset,dst_y_offset,dst_uv_offset,src_y_size,dst_y_size;
 	int scale_times,w,h;
-	int ret = 0, scale_crop_ret=0;
+	int y_start,y_end;
+	int ret = 0;
+	unsigned int row_err = 0;
 
+    trace_rk_camera_scale_start(pcdev->hostid, vb->i, RK_CAM_ENGINE_IPP, pcdev->zoominfo.a.c.width, pcdev->zoominfo.a.c.height,
+                                pcdev->icd->user_width, pcdev->icd->user_height);
     /*
     *ddl@rock-chips.com: 
     * IPP Dest image resolution is 2047x1088, so scale operation break up some times
@@ -1135,17 +1655,30 @@ static int rk_camera_scale_crop_ipp(struct work_struct *work)
     		ipp_req.src0.CbrMst = vipdata_base + src_y_size + src_uv_offset;
     		ipp_req.dst0.YrgbMst = vb->boff + dst_y_offset;
     		ipp_req.dst0.CbrMst = vb->boff + dst_y_size + dst_uv_offset;
-    		
+
+            /* failed tile is retried once, the others tiles are continued */
             if (ipp_blit_sync(&ipp_req)){
-                RKCAMERA_TR("ipp do erro, so switch to arm \n");
-                scale_crop_ret = 0x01;
-                break;
+                RKCAMERA_TR("ipp tile(%d,%d) do erro, do again\n",w,h);
+                if (ipp_blit_sync(&ipp_req)) {
+                    RKCAMERA_TR("ipp tile(%d,%d) do erro again, so switch to arm \n",w,h);
+                    row_err |= (0x01<<h);
+                }
             }
         }
     }
 
-    if (scale_crop_ret == 0x01) {
-        ret = rk_camera_scale_crop_arm(work);
+    /* 
+    * only the tile rows which ipp failed are done by arm, rows cover the ipp tile 
+    * destination [user_height*h/scale_times, +dst0.h) rounded out to even.
+    */
+    for (h=0; (h<scale_times) && (ret == 0); h++) {
+        if (row_err & (0x01<<h)) {
+            y_start = pcdev->icd->user_height*h/scale_times;
+            y_end = ((y_start + ipp_req.dst0.h + 1)&(~0x01));
+            if ((h == scale_times - 1) || (y_end > pcdev->icd->user_height))
+                y_end = pcdev->icd->user_height;
+            ret = rk_camera_scale_crop_arm_rows(work, y_start&(~0x01), y_end);
+        }
     }
 
     if (ret) {
@@ -1153,7 +1686,7 @@ static int rk_camera_scale_crop_ipp(struct work_struct *work)
 		vb->state = VIDEOBUF_NEEDS_INIT;
 		spin_unlock_irqrestore(&pcdev->lock, flags);
 		RKCAMERA_TR("Capture image(vb->i:0x%x) which IPP and ARM operated is error:\n",vb->i);
-		RKCAMERA_TR("widx:%d hidx:%d ",w,h);
+		RKCAMERA_TR("ipp failed tile rows:0x%x ",row_err);
 		RKCAMERA_TR("%dx%d@(%d,%d)->%dx%d\n",pcdev->zoominfo.a.c.width,pcdev->zoominfo.a.c.height,pcdev->zoominfo.a.c.left,pcdev->zoominfo.a.c.top,pcdev->icd->user_width,pcdev->icd->user_height);
 		RKCAMERA_TR("ipp_req.src0.YrgbMst:0x%x ipp_req.src0.CbrMst:0x%x \n", ipp_req.src0.YrgbMst,ipp_req.src0.CbrMst);
 		RKCAMERA_TR("ipp_req.src0.w:0x%x ipp_req.src0.h:0x%x \n",ipp_req.src0.w,ipp_req.src0.h);
@@ -1165,70 +1698,119 @@ static int rk_camera_scale_crop_ipp(struct work_struct *work)
 		RKCAMERA_TR("ipp_req.timeout:0x%x ipp_req.flag :0x%x\n",ipp_req.timeout,ipp_req.flag);
     }
     
+    trace_rk_camera_scale_end(pcdev->hostid, vb->i, RK_CAM_ENGINE_IPP, ret);
 	return ret;    
 }
 #endif
-static int rk_camera_scale_crop_arm(struct work_struct *work)
+/*
+ * Locking: Caller holds zoominfo->sem
+ * Column index and weight of rk_camera_scale_crop_arm are only depend on
+ * src width, crop width and dst width, so calculate them once after zoominfo is changed.
+ */
+static int rk_camera_scale_coeff_update(struct rk_camera_zoominfo *zoominfo, int dst_w)
 {
-    struct rk_camera_work *camera_work = container_of(work, struct rk_camera_work, work);	
-    struct videobuf_buffer *vb = camera_work->vb;	
-    struct rk_camera_dev *pcdev = camera_work->pcdev;	
-    struct rk29_camera_vbinfo *vb_info;        
+    struct rk_camera_scale_coeff *coeff = &zoominfo->coeff;
+    int src_w = zoominfo->vir_width;
+    int crop_w = zoominfo->a.c.width;
+    long zoomindstxIntInv,sX;
+    int x;
+
+    if ((coeff->src_w == src_w) && (coeff->crop_w == crop_w) && (coeff->dst_w == dst_w))
+        return 0;
+
+    coeff->dst_w = 0;
+    if ((src_w < 2) || (dst_w < 2))
+        return -EINVAL;
+
+    if (coeff->size < dst_w) {
+        kfree(coeff->x_coeff);
+        coeff->x_coeff = kmalloc(sizeof(unsigned short)*dst_w*3, GFP_KERNEL);
+        if (coeff->x_coeff == NULL) {
+            coeff->size = 0;
+            RKCAMERA_TR("scale coeff kmalloc fail\n");
+            return -ENOMEM;
+        }
+        coeff->size = dst_w;
+    }
+    coeff->y_sx = coeff->x_coeff + coeff->size;
+    coeff->uv_sx = coeff->y_sx + coeff->size;
+
+    zoomindstxIntInv = ((unsigned long)(crop_w)<<16)/dst_w + 1;
+    for (x=0; x<dst_w; x++) {
+        coeff->x_coeff[x] = (x*zoomindstxIntInv)&0xffff;
+        sX = (x*zoomindstxIntInv >> 16);
+        coeff->y_sx[x] = (sX >= src_w - 1)? (src_w - 2) : sX;
+    }
+    for (x=0; x<dst_w/2; x++) {
+        sX = (x*zoomindstxIntInv >> 16);
+        coeff->uv_sx[x] = ((sX >= src_w/2 - 1)? (src_w/2 - 2) : sX)*2;
+    }
+
+    coeff->src_w = src_w;
+    coeff->crop_w = crop_w;
+    coeff->dst_w = dst_w;
+    return 0;
+}
+static void rk_camera_scale_coeff_free(struct rk_camera_zoominfo *zoominfo)
+{
+    kfree(zoominfo->coeff.x_coeff);
+    memset(&zoominfo->coeff, 0x00, sizeof(struct rk_camera_scale_coeff));
+}
+/*
+ * Scale rows [y_start,y_end) of Y plane and rows [y_start/2,y_end/2) of UV plane,
+ * y_start must be even, so bands of one frame don't overlap in UV plane.
+ */
+static void rk_camera_scale_crop_arm_band(struct rk_camera_dev *pcdev, int y_start, int y_end)
+{
+    struct rk_camera_scale_job *job = &pcdev->scale_job;
     unsigned char *psY,*pdY,*psUV,*pdUV; 
-    unsigned char *src,*dst;
-    unsigned long src_phy,dst_phy;
-    int srcW,srcH,cropW,cropH,dstW,dstH;
-    long zoomindstxIntInv,zoomindstyIntInv;
+    unsigned char *psRow0,*psRow1,*psPix0,*psPix1;
+    unsigned short *x_coeff,*y_sx,*uv_sx;
+    int srcW,srcH,dstW,dstH;
+    long zoomindstyIntInv;
     long x,y;
-    long yCoeff00,yCoeff01,xCoeff00,xCoeff01;
+    long yCoeff00,xCoeff00;
     long sX,sY;
     long r0,r1,a,b,c,d;
-    int ret = 0, shift_bits = 0;
-
-    src_phy = pcdev->vipmem_phybase + vb->i*pcdev->vipmem_bsize;    
-    src = psY = (unsigned char*)(pcdev->vipmem_virbase + vb->i*pcdev->vipmem_bsize);
-    psUV = psY + pcdev->zoominfo.vir_width*pcdev->zoominfo.vir_height;
-	
-    srcW = pcdev->zoominfo.vir_width;
-    srcH = pcdev->zoominfo.vir_height;
-    cropW = pcdev->zoominfo.a.c.width;
-    cropH = pcdev->zoominfo.a.c.height;
-	
-    psY = psY + pcdev->zoominfo.a.c.top*pcdev->zoominfo.vir_width+pcdev->zoominfo.a.c.left;
-    psUV = psUV + pcdev->zoominfo.a.c.top*pcdev->zoominfo.vir_width/2+pcdev->zoominfo.a.c.left; 
-    
-    vb_info = pcdev->vbinfo+vb->i; 
-    dst_phy = vb_info->phy_addr;
-    dst = pdY = (unsigned char*)vb_info->vir_addr; 
-    pdUV = pdY + pcdev->icd->user_width*pcdev->icd->user_height;
-    dstW = pcdev->icd->user_width;
-    dstH = pcdev->icd->user_height;
+    int shift_bits;
+
+    psY = job->psY;
+    psUV = job->psUV;
+    srcW = job->srcW;
+    srcH = job->srcH;
+    dstW = job->dstW;
+    dstH = job->dstH;
+    zoomindstyIntInv = job->zoomindstyIntInv;
+    shift_bits = job->shift_bits;
+    x_coeff = pcdev->zoominfo.coeff.x_coeff;
+    y_sx = pcdev->zoominfo.coeff.y_sx;
+    uv_sx = pcdev->zoominfo.coeff.uv_sx;
+    pdY = job->pdY + y_start*dstW;
+    pdUV = job->pdUV + (y_start/2)*dstW;
 
-    zoomindstxIntInv = ((unsigned long)(cropW)<<16)/dstW + 1;
-    zoomindstyIntInv = ((unsigned long)(cropH)<<16)/dstH + 1;
-#ifdef CONFIG_SOC_RK3028
-	shift_bits = (pcdev->chip_id == 0x42)?0:2;
-#endif
+    /*
+    * row pointers are fetched once per line, and a*xCoeff01 + b*xCoeff00 is evaluated
+    * as (a<<16) - a + (b-a)*xCoeff00, it is same value with one multiply per lerp.
+    * column index and xCoeff00 are loaded from tables of rk_camera_scale_coeff_update.
+    */
     //y
-    //for(y = 0; y<dstH - 1 ; y++ ) {   
-    for(y = 0; y<dstH; y++ ) {   
+    for(y = y_start; y<y_end; y++ ) {   
         yCoeff00 = (y*zoomindstyIntInv)&0xffff;
-        yCoeff01 = 0xffff - yCoeff00; 
         sY = (y*zoomindstyIntInv >> 16);
         sY = (sY >= srcH - 1)? (srcH - 2) : sY;      
+        psRow0 = psY + sY*srcW;
+        psRow1 = psRow0 + srcW;
         for(x = 0; x<dstW; x++ ) {
-            xCoeff00 = (x*zoomindstxIntInv)&0xffff;
-            xCoeff01 = 0xffff - xCoeff00; 	
-            sX = (x*zoomindstxIntInv >> 16);
-            sX = (sX >= srcW -1)?(srcW- 2) : sX;
-            a = (psY[sY*srcW + sX]<<shift_bits);
-            b = (psY[sY*srcW + sX + 1]<<shift_bits);
-            c = (psY[(sY+1)*srcW + sX]<<shift_bits);
-            d = (psY[(sY+1)*srcW + sX + 1]<<shift_bits);
-
-            r0 = (a * xCoeff01 + b * xCoeff00)>>16 ;
-            r1 = (c * xCoeff01 + d * xCoeff00)>>16 ;
-            r0 = (r0 * yCoeff01 + r1 * yCoeff00)>>16;
+            xCoeff00 = x_coeff[x];
+            sX = y_sx[x];
+            a = (psRow0[sX]<<shift_bits);
+            b = (psRow0[sX + 1]<<shift_bits);
+            c = (psRow1[sX]<<shift_bits);
+            d = (psRow1[sX + 1]<<shift_bits);
+
+            r0 = ((a<<16) - a + (b - a) * xCoeff00)>>16;
+            r1 = ((c<<16) - c + (d - c) * xCoeff00)>>16;
+            r0 = ((r0<<16) - r0 + (r1 - r0) * yCoeff00)>>16;
 
             pdY[x] = r0;
         }
@@ -1236,67 +1818,297 @@ static int rk_camera_scale_crop_arm(struct work_struct *work)
     }
 
     dstW /= 2;
-    dstH /= 2;
     srcW /= 2;
     srcH /= 2;
 
-    //UV
-    //for(y = 0; y<dstH - 1 ; y++ ) {
-    for(y = 0; y<dstH; y++ ) {
+    //UV, U and V are interleaved, so src line stride is srcW*2
+    for(y = y_start/2; y<y_end/2; y++ ) {
         yCoeff00 = (y*zoomindstyIntInv)&0xffff;
-        yCoeff01 = 0xffff - yCoeff00; 
         sY = (y*zoomindstyIntInv >> 16);
         sY = (sY >= srcH -1)? (srcH - 2) : sY;      
+        psRow0 = psUV + sY*srcW*2;
+        psRow1 = psRow0 + srcW*2;
         for(x = 0; x<dstW; x++ ) {
-            xCoeff00 = (x*zoomindstxIntInv)&0xffff;
-            xCoeff01 = 0xffff - xCoeff00; 	
-            sX = (x*zoomindstxIntInv >> 16);
-            sX = (sX >= srcW -1)?(srcW- 2) : sX;
+            xCoeff00 = x_coeff[x];
+            psPix0 = psRow0 + uv_sx[x];
+            psPix1 = psRow1 + uv_sx[x];
             //U
-            a = (psUV[(sY*srcW + sX)*2]<<shift_bits);
-            b = (psUV[(sY*srcW + sX + 1)*2]<<shift_bits);
-            c = (psUV[((sY+1)*srcW + sX)*2]<<shift_bits);
-            d = (psUV[((sY+1)*srcW + sX + 1)*2]<<shift_bits);
-			
+            a = (psPix0[0]<<shift_bits);
+            b = (psPix0[2]<<shift_bits);
+            c = (psPix1[0]<<shift_bits);
+            d = (psPix1[2]<<shift_bits);
 
-            r0 = (a * xCoeff01 + b * xCoeff00)>>16 ;
-            r1 = (c * xCoeff01 + d * xCoeff00)>>16 ;
-            r0 = (r0 * yCoeff01 + r1 * yCoeff00)>>16;
+            r0 = ((a<<16) - a + (b - a) * xCoeff00)>>16;
+            r1 = ((c<<16) - c + (d - c) * xCoeff00)>>16;
+            r0 = ((r0<<16) - r0 + (r1 - r0) * yCoeff00)>>16;
 
             pdUV[x*2] = r0;
 
             //V
-            a = (psUV[(sY*srcW + sX)*2 + 1]<<shift_bits);
-            b = (psUV[(sY*srcW + sX + 1)*2 + 1]<<shift_bits);
-            c = (psUV[((sY+1)*srcW + sX)*2 + 1]<<shift_bits);
-            d = (psUV[((sY+1)*srcW + sX + 1)*2 + 1]<<shift_bits);
-			
-            r0 = (a * xCoeff01 + b * xCoeff00)>>16 ;
-            r1 = (c * xCoeff01 + d * xCoeff00)>>16 ;
-            r0 = (r0 * yCoeff01 + r1 * yCoeff00)>>16;
+            a = (psPix0[1]<<shift_bits);
+            b = (psPix0[3]<<shift_bits);
+            c = (psPix1[1]<<shift_bits);
+            d = (psPix1[3]<<shift_bits);
+
+            r0 = ((a<<16) - a + (b - a) * xCoeff00)>>16;
+            r1 = ((c<<16) - c + (d - c) * xCoeff00)>>16;
+            r0 = ((r0<<16) - r0 + (r1 - r0) * yCoeff00)>>16;
 
             pdUV[x*2 + 1] = r0;
         }
         pdUV += dstW*2;
     }
+}
+/* Same order as dma-mapping dev_to_cpu, outer cache must be invalidated first */
+static inline void rk_camera_cache_inv(void *vaddr, unsigned long paddr, size_t size)
+{
+    outer_inv_range((phys_addr_t)paddr,(phys_addr_t)(paddr+size));
+    dmac_unmap_area(vaddr,size,DMA_FROM_DEVICE);
+}
+/*
+ * Clean and invalidate, dst lines written by arm mustn't stay in cache, because app or next engine may read
+ * this videobuf by its own mapping after cif/ipp writes it again. Inner cache must be flushed first.
+ */
+static inline void rk_camera_cache_flush(void *vaddr, unsigned long paddr, size_t size)
+{
+    dmac_flush_range(vaddr,vaddr+size);
+    outer_flush_range((phys_addr_t)paddr,(phys_addr_t)(paddr+size));
+}
+static void rk_camera_scale_band_work(struct work_struct *work)
+{
+    struct rk_camera_scale_band *band = container_of(work, struct rk_camera_scale_band, work);
+    struct rk_camera_scale_job *job = &band->pcdev->scale_job;
+
+    rk_camera_scale_crop_arm_band(band->pcdev, band->y_start, band->y_end);
+    if (atomic_dec_and_test(&job->pending))
+        complete(&job->done);
+}
+/*
+ * Scale dst rows [y_start,y_end) of camera_work->vb by arm, y_start must be even;
+ * Locking: Caller holds zoominfo.sem
+ */
+static int rk_camera_scale_crop_arm_rows(struct work_struct *work, int y_start, int y_end)
+{
+    struct rk_camera_work *camera_work = container_of(work, struct rk_camera_work, work);	
+    struct videobuf_buffer *vb = camera_work->vb;	
+    struct rk_camera_dev *pcdev = camera_work->pcdev;	
+    struct rk_camera_scale_job *job = &pcdev->scale_job;
+    struct rk29_camera_vbinfo *vb_info;        
+    unsigned char *psY,*pdY;
+    unsigned char *src;
+    unsigned long src_phy,dst_phy;
+    long row0,row1;
+    size_t len;
+    int bands,band_h,cpu,i;
+    int ret = 0;
+
+    src_phy = pcdev->vipmem_phybase + vb->i*pcdev->vipmem_bsize;    
+    src = psY = (unsigned char*)(pcdev->vipmem_virbase + vb->i*pcdev->vipmem_bsize);
+    job->psUV = psY + pcdev->zoominfo.vir_width*pcdev->zoominfo.vir_height;
+	
+    job->srcW = pcdev->zoominfo.vir_width;
+    job->srcH = pcdev->zoominfo.vir_height;
+	
+    job->psY = psY + pcdev->zoominfo.a.c.top*pcdev->zoominfo.vir_width+pcdev->zoominfo.a.c.left;
+    job->psUV = job->psUV + pcdev->zoominfo.a.c.top*pcdev->zoominfo.vir_width/2+pcdev->zoominfo.a.c.left; 
     
-    dmac_flush_range((void*)src,(void*)(src+pcdev->vipmem_bsize));
-    outer_flush_range((phys_addr_t)src_phy,(phys_addr_t)(src_phy+pcdev->vipmem_bsize));
+    vb_info = pcdev->vbinfo+vb->i; 
+    dst_phy = vb_info->phy_addr;
+    pdY = (unsigned char*)vb_info->vir_addr; 
+    job->pdY = pdY;
+    job->pdUV = pdY + pcdev->icd->user_width*pcdev->icd->user_height;
+    job->dstW = pcdev->icd->user_width;
+    job->dstH = pcdev->icd->user_height;
+
+    y_end = MIN(y_end, job->dstH);
+    if (y_start >= y_end)
+        return 0;
+
+    ret = rk_camera_scale_coeff_update(&pcdev->zoominfo, job->dstW);
+    if (ret)
+        return ret;
+    job->zoomindstyIntInv = ((unsigned long)(pcdev->zoominfo.a.c.height)<<16)/job->dstH + 1;
+    job->shift_bits = 0;
+#ifdef CONFIG_SOC_RK3028
+	job->shift_bits = (pcdev->chip_id == 0x42)?0:2;
+#endif
+
+    /*
+    * Src is only read by cpu, so invalidate the rows which scaler read before reading them;
+    * dst is only written by cpu, so clean the written extent after scale.
+    * the extent is calculated from [y_start,y_end).
+    */
+    row0 = MIN(((y_start*job->zoomindstyIntInv)>>16), (job->srcH-2));
+    row1 = MIN((((y_end-1)*job->zoomindstyIntInv)>>16), (job->srcH-2)) + 1;
+    len = MIN((size_t)((row1 - row0 + 1)*job->srcW), (size_t)(src + pcdev->vipmem_bsize - (job->psY + row0*job->srcW)));      /* never touch memory out of this vipmem block */
+    rk_camera_cache_inv(job->psY + row0*job->srcW, src_phy + (job->psY + row0*job->srcW - src), len);
+    if (y_end/2 > y_start/2) {
+        row0 = MIN((((y_start/2)*job->zoomindstyIntInv)>>16), (job->srcH/2-2));
+        row1 = MIN((((y_end/2-1)*job->zoomindstyIntInv)>>16), (job->srcH/2-2)) + 1;
+        len = MIN((size_t)((row1 - row0 + 1)*job->srcW), (size_t)(src + pcdev->vipmem_bsize - (job->psUV + row0*job->srcW)));
+        rk_camera_cache_inv(job->psUV + row0*job->srcW, src_phy + (job->psUV + row0*job->srcW - src), len);
+    }
+
+    /* 
+    * Frame is split to horizontal bands, which are scaled on online cpus in parallel,
+    * band height is even for UV plane.
+    */
+    get_online_cpus();
+    bands = 1;
+    if (pcdev->scale_wq)
+        bands = min_t(int, num_online_cpus(), RK_CAM_SCALE_BAND_MAX);
+    band_h = ((y_end - y_start + bands - 1)/bands + 1) & (~0x01);
+    INIT_COMPLETION(job->done);
+    atomic_set(&job->pending, bands);
+    cpu = raw_smp_processor_id();
+    for (i=1; i<bands; i++) {
+        cpu = cpumask_next(cpu, cpu_online_mask);
+        if (cpu >= nr_cpu_ids)
+            cpu = cpumask_first(cpu_online_mask);
+        job->band[i].y_start = min(y_start + i*band_h, y_end);
+        job->band[i].y_end = (i == bands - 1) ? y_end : min(y_start + (i+1)*band_h, y_end);
+        queue_work_on(cpu, pcdev->scale_wq, &job->band[i].work);
+    }
+    rk_camera_scale_crop_arm_band(pcdev, y_start, (bands == 1) ? y_end : min(y_start + band_h, y_end));
+    if (!atomic_dec_and_test(&job->pending))
+        wait_for_completion(&job->done);
+    put_online_cpus();
     
-    dmac_flush_range((void*)dst,(void*)(dst+vb_info->size));
-    outer_flush_range((phys_addr_t)dst_phy,(phys_addr_t)(dst_phy+vb_info->size));
+    len = MIN((size_t)((y_end - y_start)*job->dstW), (size_t)(vb_info->size - y_start*job->dstW));
+    rk_camera_cache_flush(job->pdY + y_start*job->dstW, dst_phy + y_start*job->dstW, len);
+    if (y_end/2 > y_start/2) {
+        len = MIN((size_t)((y_end/2 - y_start/2)*job->dstW), (size_t)(pdY + vb_info->size - (job->pdUV + (y_start/2)*job->dstW)));
+        rk_camera_cache_flush(job->pdUV + (y_start/2)*job->dstW, dst_phy + (job->pdUV + (y_start/2)*job->dstW - pdY), len);
+    }
 
 	return ret;    
 }
+static int rk_camera_scale_crop_arm(struct work_struct *work)
+{
+    struct rk_camera_work *camera_work = container_of(work, struct rk_camera_work, work);	
+    struct rk_camera_dev *pcdev = camera_work->pcdev;
+    int ret;
+
+    trace_rk_camera_scale_start(pcdev->hostid, camera_work->vb->i, RK_CAM_ENGINE_ARM, pcdev->zoominfo.a.c.width, pcdev->zoominfo.a.c.height,
+                                pcdev->icd->user_width, pcdev->icd->user_height);
+    ret = rk_camera_scale_crop_arm_rows(work, 0, pcdev->icd->user_height);
+    trace_rk_camera_scale_end(pcdev->hostid, camera_work->vb->i, RK_CAM_ENGINE_ARM, ret);
+    return ret;
+}
+#if RK_CAM_SCALE_CROP_SEL
+static int (*rk_camera_scale_crop_engine(unsigned int engine))(struct work_struct *work)
+{
+    switch (engine)
+    {
+#if RK_CAM_SCALE_CROP_RGA_EN
+        case RK_CAM_ENGINE_RGA:
+            return rk_camera_scale_crop_rga;
+#endif
+        case RK_CAM_ENGINE_IPP:
+            return rk_camera_scale_crop_ipp;
+        default:
+            return rk_camera_scale_crop_arm;
+    }
+}
+/*
+ * Select scale_crop_cb for the stream: RGB is only converted by RGA; IPP can't output some width;
+ * the engine which measured cost is lower is used. If the cost of ARM or IPP isn't measured, ARM is
+ * for small output and IPP for others, and the other one is run on a probe frame to measure its cost.
+ * Locking: Caller holds zoominfo.sem
+ */
+static void rk_camera_scale_crop_select(struct rk_camera_dev *pcdev, unsigned int fourcc, int usr_w, int usr_h)
+{
+    unsigned int engine;
+    bool ipp_en;
+
+    pcdev->scale_probe = RK_CAM_ENGINE_NUM;
+    pcdev->scale_frames = 0;
+
+    if (usr_w > 0x7f0) {
+        ipp_en = !(((usr_w>>1)&0x3f) && (((usr_w>>1)&0x3f) <= 8));
+    } else {
+        ipp_en = !((usr_w&0x3f) && ((usr_w&0x3f) <= 8));
+    }
+    
+    if ((fourcc == V4L2_PIX_FMT_RGB565) || (fourcc == V4L2_PIX_FMT_RGB24)) {
+        engine = RK_CAM_ENGINE_RGA;
+    } else if ((scale_crop == 1) && ipp_en) {
+        engine = RK_CAM_ENGINE_IPP;
+    } else if ((scale_crop != 0) || (ipp_en == false)) {
+        engine = RK_CAM_ENGINE_ARM;
+    } else if (pcdev->scale_cost[RK_CAM_ENGINE_ARM] && pcdev->scale_cost[RK_CAM_ENGINE_IPP]) {
+        engine = (pcdev->scale_cost[RK_CAM_ENGINE_ARM] <= pcdev->scale_cost[RK_CAM_ENGINE_IPP]) ? RK_CAM_ENGINE_ARM : RK_CAM_ENGINE_IPP;
+    } else {
+        engine = (usr_w*usr_h <= RK_CAM_ENGINE_ARM_SIZE) ? RK_CAM_ENGINE_ARM : RK_CAM_ENGINE_IPP;
+        pcdev->scale_probe = (engine == RK_CAM_ENGINE_ARM) ? RK_CAM_ENGINE_IPP : RK_CAM_ENGINE_ARM;
+    }
+
+#if RK_CAM_SCALE_CROP_RGA_EN
+    if ((engine == RK_CAM_ENGINE_RGA) && (pcdev->rga_en == false))
+        engine = RK_CAM_ENGINE_ARM;
+#else
+    if (engine == RK_CAM_ENGINE_RGA)
+        engine = RK_CAM_ENGINE_ARM;
+#endif
+    pcdev->icd_cb.scale_crop_cb = rk_camera_scale_crop_engine(engine);
+    /* crop is aligned for both ipp and arm, if they are both run in this stream */
+    pcdev->crop_align = ((engine == RK_CAM_ENGINE_ARM) || (pcdev->scale_probe != RK_CAM_ENGINE_NUM)) ? 0x0f : 0x03;
+    pcdev->scale_engine = engine;
+    RKCAMERA_DG1("scale crop engine: %d(cost: arm %d ipp %d rga %d) for %c%c%c%c %dx%d\n",engine,
+                pcdev->scale_cost[RK_CAM_ENGINE_ARM],pcdev->scale_cost[RK_CAM_ENGINE_IPP],pcdev->scale_cost[RK_CAM_ENGINE_RGA],
+                fourcc & 0xff, (fourcc >> 8) & 0xff,(fourcc >> 16) & 0xff, (fourcc >> 24) & 0xff, usr_w, usr_h);
+}
+/* 
+ * The probe engine is run once on RK_CAM_SCALE_PROBE_FRAME frame, the first frame isn't measured for cold cache.
+ * Locking: Caller holds zoominfo.sem 
+ */
+static unsigned int rk_camera_scale_engine_get(struct rk_camera_dev *pcdev)
+{
+    if ((pcdev->scale_probe != RK_CAM_ENGINE_NUM) && (pcdev->scale_frames == RK_CAM_SCALE_PROBE_FRAME))
+        return pcdev->scale_probe;
+    return pcdev->scale_engine;
+}
+/* Locking: Caller holds zoominfo.sem */
+static void rk_camera_scale_cost_update(struct rk_camera_dev *pcdev, unsigned int engine, s64 ns)
+{
+    unsigned int pixels = pcdev->icd->user_width*pcdev->icd->user_height;
+    unsigned int cost,*avg = &pcdev->scale_cost[engine];
+
+    if (pcdev->scale_frames++ == 0)
+        return;
+    if (pixels == 0)
+        return;
+    cost = (unsigned int)div_u64((u64)ns<<4, pixels);
+    if (cost == 0)
+        cost = 1;
+    *avg = (*avg == 0) ? cost : ((*avg*7 + cost)>>3);
+
+    if (engine != pcdev->scale_engine) {
+        /* probe is done, switch to it if it is cheaper; crop_align is fit for both */
+        pcdev->scale_probe = RK_CAM_ENGINE_NUM;
+        if (pcdev->scale_cost[engine] < pcdev->scale_cost[pcdev->scale_engine]) {
+            pcdev->scale_engine = engine;
+            pcdev->icd_cb.scale_crop_cb = rk_camera_scale_crop_engine(engine);
+        }
+        RKCAMERA_DG1("scale crop engine: %d(cost: arm %d ipp %d) after probe\n",pcdev->scale_engine,
+                    pcdev->scale_cost[RK_CAM_ENGINE_ARM],pcdev->scale_cost[RK_CAM_ENGINE_IPP]);
+    }
+}
+#endif
 static void rk_camera_capture_process(struct work_struct *work)
 {
     struct rk_camera_work *camera_work = container_of(work, struct rk_camera_work, work);    
     struct videobuf_buffer *vb = camera_work->vb;    
     struct rk_camera_dev *pcdev = camera_work->pcdev;    
     //enum v4l2_mbus_pixelcode icd_code = pcdev->icd->current_fmt->code;    
-    unsigned long flags = 0;    
     int err = 0;    
+    ktime_t ts;
+#if RK_CAM_SCALE_CROP_SEL
+    unsigned int engine;
+#endif
 
+    trace_rk_camera_process_start(pcdev->hostid, vb->i, camera_work->ts, 0);
+    rk_camera_latency_add(pcdev, RK_CAM_LAT_IRQ2WORK, camera_work->ts, ktime_get());
     if (atomic_read(&pcdev->stop_cif)==true) {
         err = -EINVAL;
         goto rk_camera_capture_process_end; 
@@ -1309,7 +2121,19 @@ static void rk_camera_capture_process(struct work_struct *work)
     
     down(&pcdev->zoominfo.sem);
     if (pcdev->icd_cb.scale_crop_cb){
+        ts = ktime_get();
+#if RK_CAM_SCALE_CROP_SEL
+        engine = rk_camera_scale_engine_get(pcdev);
+        err = (rk_camera_scale_crop_engine(engine))(work);
+        rk_camera_latency_add(pcdev, RK_CAM_LAT_SCALE+engine, ts, ktime_get());
+        if (err == 0)
+            rk_camera_scale_cost_update(pcdev, engine, ktime_to_ns(ktime_sub(ktime_get(), ts)));
+        else if (engine != pcdev->scale_engine)
+            pcdev->scale_probe = RK_CAM_ENGINE_NUM;
+#else
         err = (pcdev->icd_cb.scale_crop_cb)(work);
+        rk_camera_latency_add(pcdev, RK_CAM_LAT_SCALE+pcdev->scale_engine, ts, ktime_get());
+#endif
     	}
     up(&pcdev->zoominfo.sem); 
     
@@ -1325,10 +2149,10 @@ rk_camera_capture_process_end:
 	        vb->field_count++;
 		}
     }       
-    spin_lock_irqsave(&pcdev->camera_work_lock, flags);    
-    list_add_tail(&camera_work->queue, &pcdev->camera_work_queue);    
-    spin_unlock_irqrestore(&pcdev->camera_work_lock, flags); 
-    wake_up(&(camera_work->vb->done));     /* ddl@rock-chips.com : v0.3.9 */ 
+    /* camera_work may be popped by irq at once after push, so wake up vb by local pointer */
+    trace_rk_camera_process_done(pcdev->hostid, vb->i, camera_work->ts, err);
+    rk_camera_work_push(pcdev, camera_work);
+    rk_camera_vb_done(pcdev, vb);     /* ddl@rock-chips.com : v0.3.9 */ 
     return;
 }
 
@@ -1341,9 +2165,7 @@ static void rk_camera_cifrest_delay(struct work_struct *work)
     mdelay(1);
     rk_camera_cif_reset(pcdev,false);
 
-    spin_lock_irqsave(&pcdev->camera_work_lock, flags);    
-    list_add_tail(&camera_work->queue, &pcdev->camera_work_queue);    
-    spin_unlock_irqrestore(&pcdev->camera_work_lock, flags); 
+    rk_camera_work_push(pcdev, camera_work);
 
     spin_lock_irqsave(&pcdev->lock,flags);
     if (atomic_read(&pcdev->stop_cif) == false) {
@@ -1359,6 +2181,7 @@ static inline irqreturn_t rk_camera_cifirq(int irq, void *data)
     struct rk_camera_dev *pcdev = data;
     struct rk_camera_work *wk;
     unsigned int reg_cifctrl,reg_lastpix,reg_lastline;
+    unsigned long drop_idx;
 
     write_cif_reg(pcdev->base,CIF_CIF_INTSTAT,0x0200);  /* clear vip interrupte single  */
     
@@ -1375,108 +2198,157 @@ static inline irqreturn_t rk_camera_cifirq(int irq, void *data)
         pcdev->irqinfo.cifirq_normal_idx = pcdev->irqinfo.cifirq_idx;
     }
     
-    if(reg_cifctrl & ENABLE_CAPTURE) {
+    /* Cif keep capture in pingpong mode, the other frame may be receiving data */
+    if (!CAM_PINGPONG_IS_EN() && (reg_cifctrl & ENABLE_CAPTURE)) {
         write_cif_reg(pcdev->base,CIF_CIF_CTRL, (reg_cifctrl & ~ENABLE_CAPTURE));
     } 
 
     if (pcdev->irqinfo.cifirq_abnormal_idx>0) {
         if ((pcdev->irqinfo.cifirq_idx - pcdev->irqinfo.cifirq_abnormal_idx) == 1 ) {
-            if (!list_empty(&pcdev->camera_work_queue)) {
+            wk = rk_camera_work_pop(pcdev);
+            if (wk) {
                 RKCAMERA_DG2("Receive cif irq-%ld and queue work to cif reset\n",pcdev->irqinfo.cifirq_idx);
-                wk = list_entry(pcdev->camera_work_queue.next, struct rk_camera_work, queue);
-                list_del_init(&wk->queue);
                 INIT_WORK(&(wk->work), rk_camera_cifrest_delay);
                 wk->pcdev = pcdev;                
                 queue_work(pcdev->camera_wq, &(wk->work));
-            }  
+            } else {
+                drop_idx = rk_camera_latency_drop(pcdev);
+                RKCAMERA_TR("camera work pool is empty(%ld times), cif reset is dropped!\n",drop_idx);
+            }
         }
     }
     
     return IRQ_HANDLED;
 }
 
-static inline irqreturn_t rk_camera_dmairq(int irq, void *data)
+/*
+ * Frame interval and jitter are averaged by every frame(1/8 and 1/16 weight), they follow the source rate change.
+ * Locking: Caller holds pcdev->lock
+ */
+static inline void rk_camera_frame_stat_update(struct rk_camera_dev *pcdev, ktime_t ts)
+{
+    s64 us = ktime_us_delta(ts, pcdev->frame_last);
+    int x,d;
+
+    if (pcdev->frame_last.tv64 && (us > 0)) {
+        x = (int)(MIN(us, (s64)0x7ffffff)<<4);
+        if (pcdev->frame_interval_avg == 0) {
+            pcdev->frame_interval_avg = x;
+        } else {
+            d = x - (int)pcdev->frame_interval_avg;
+            pcdev->frame_interval_avg += d/8;
+            pcdev->frame_jitter += ((d<0 ? -d : d) - (int)pcdev->frame_jitter)/16;
+        }
+        pcdev->frame_interval = pcdev->frame_interval_avg>>4;
+    }
+    if (us != 0)
+        pcdev->frame_last = ts;
+}
+static inline void rk_camera_frame_done(struct rk_camera_dev *pcdev, int frame)
 {
-    struct rk_camera_dev *pcdev = data;
     struct videobuf_buffer *vb;
 	struct rk_camera_work *wk;
-	struct timeval tv;
-    unsigned long reg_cifctrl;
+    unsigned long drop_idx;
 
-    reg_cifctrl = read_cif_reg(pcdev->base,CIF_CIF_CTRL);
-    /* ddl@rock-chps.com : Current VIP is run in One Frame Mode, Frame 1 is validate */
-    if (read_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS) & 0x01) {
-        write_cif_reg(pcdev->base,CIF_CIF_INTSTAT,0x01);  /* clear vip interrupte single  */
-
-        pcdev->irqinfo.dmairq_idx++;
-        if (pcdev->irqinfo.cifirq_abnormal_idx == pcdev->irqinfo.dmairq_idx) {
+    pcdev->irqinfo.dmairq_idx++;
+    if (pcdev->irqinfo.cifirq_abnormal_idx == pcdev->irqinfo.dmairq_idx) {
+        if (CAM_PINGPONG_IS_EN()) {
+            rk_videobuf_capture(pcdev->active[frame],pcdev,frame);
+        } else {
             write_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS,  0x00000002);
-            goto end;
         }
+        return;
+    }
 
-        if (!pcdev->fps) {
-            do_gettimeofday(&pcdev->first_tv);            
-        }
-        pcdev->fps++;
-        if (!pcdev->active)
-            goto end;
-        if (pcdev->frame_inval>0) {
-            pcdev->frame_inval--;
-            rk_videobuf_capture(pcdev->active,pcdev);
-            goto end;
-        } else if (pcdev->frame_inval) {
-            RKCAMERA_TR("frame_inval : %0x",pcdev->frame_inval);
-            pcdev->frame_inval = 0;
-        }
-        
-        if(pcdev->fps == RK30_CAM_FRAME_MEASURE) {
-            do_gettimeofday(&tv);            
-            pcdev->frame_interval = ((tv.tv_sec*1000000 + tv.tv_usec) - (pcdev->first_tv.tv_sec*1000000 + pcdev->first_tv.tv_usec))
-                /(RK30_CAM_FRAME_MEASURE-1);
-        }
-        
-        vb = pcdev->active;
-        if (!vb) {
-            printk("no acticve buffer!!!\n");
-            goto end;
+    rk_camera_frame_stat_update(pcdev, pcdev->irqinfo.ts);
+    pcdev->fps++;
+    if (!pcdev->active[frame])
+        return;
+    if (pcdev->frame_inval>0) {
+        pcdev->frame_inval--;
+        rk_videobuf_capture(pcdev->active[frame],pcdev,frame);
+        return;
+    } else if (pcdev->frame_inval) {
+        RKCAMERA_TR("frame_inval : %0x",pcdev->frame_inval);
+        pcdev->frame_inval = 0;
+    }
+    
+    vb = pcdev->active[frame];
+    if (!vb) {
+        printk("no acticve buffer!!!\n");
+        return;
+    }
+    
+    /* ddl@rock-chips.com : this vb may be deleted from queue */
+    if ((vb->state == VIDEOBUF_QUEUED) || (vb->state == VIDEOBUF_ACTIVE)) {
+        list_del_init(&vb->queue);
+    }
+    pcdev->active[frame] = rk_camera_capture_next(pcdev);
+    if (pcdev->active[frame]) {
+        WARN_ON(pcdev->active[frame]->state != VIDEOBUF_QUEUED);                     
+        rk_videobuf_capture(pcdev->active[frame],pcdev,frame);
+    } else {
+        RKCAMERA_DG1("video_buf queue is empty!\n");
+    }
+
+    /* 
+    * vb->ts is monotonic time of frame end irq, sequence(field_count>>1) is dmairq_idx, 
+    * field_count++ when vb is done doesn't change sequence. 
+    */
+    vb->ts = ktime_to_timeval(pcdev->irqinfo.ts);
+    vb->field_count = pcdev->irqinfo.dmairq_idx<<1;
+    if (CAM_WORKQUEUE_IS_EN() && !(pcdev->frame_direct & (0x01<<frame))) {
+        wk = rk_camera_work_pop(pcdev);
+        if (wk) {
+            INIT_WORK(&(wk->work), rk_camera_capture_process);
+            wk->vb = vb;
+            wk->pcdev = pcdev;
+            wk->ts = pcdev->irqinfo.ts;
+            queue_work(pcdev->camera_wq, &(wk->work));
+        } else {
+            /* vb has been deleted from capture list, it must be given back to user */
+            drop_idx = rk_camera_latency_drop(pcdev);
+            RKCAMERA_DG1("camera work pool is empty(%ld times), vb(%d) is dropped!\n",drop_idx,vb->i);
+            vb->state = VIDEOBUF_ERROR;
+            rk_camera_vb_done(pcdev, vb);
         }
-        
-        /* ddl@rock-chips.com : this vb may be deleted from queue */
+    } else {
         if ((vb->state == VIDEOBUF_QUEUED) || (vb->state == VIDEOBUF_ACTIVE)) {
-            list_del_init(&vb->queue);
-        }
-        pcdev->active = NULL;
-        if (!list_empty(&pcdev->capture)) {
-            pcdev->active = list_entry(pcdev->capture.next, struct videobuf_buffer, queue);
-            if (pcdev->active) {
-                WARN_ON(pcdev->active->state != VIDEOBUF_QUEUED);                     
-                rk_videobuf_capture(pcdev->active,pcdev);
-            }
-        }
-        if (pcdev->active == NULL) {
-            RKCAMERA_DG1("video_buf queue is empty!\n");
+            vb->state = VIDEOBUF_DONE;    	        
+            vb->field_count++;
         }
+        rk_camera_vb_done(pcdev, vb);
+    }
+}
 
-        do_gettimeofday(&vb->ts);
-        if (CAM_WORKQUEUE_IS_EN()) {
-            if (!list_empty(&pcdev->camera_work_queue)) {
-                wk = list_entry(pcdev->camera_work_queue.next, struct rk_camera_work, queue);
-                list_del_init(&wk->queue);
-                INIT_WORK(&(wk->work), rk_camera_capture_process);
-                wk->vb = vb;
-                wk->pcdev = pcdev;
-                queue_work(pcdev->camera_wq, &(wk->work));
-            }             			
-        } else {
-            if ((vb->state == VIDEOBUF_QUEUED) || (vb->state == VIDEOBUF_ACTIVE)) {
-                vb->state = VIDEOBUF_DONE;    	        
-                vb->field_count++;
+static inline irqreturn_t rk_camera_dmairq(int irq, void *data)
+{
+    struct rk_camera_dev *pcdev = data;
+    unsigned long reg_cifctrl,frm_status;
+    int i,frame,first;
+
+    reg_cifctrl = read_cif_reg(pcdev->base,CIF_CIF_CTRL);
+    frm_status = read_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS);
+    if (CAM_PINGPONG_IS_EN()) {
+        write_cif_reg(pcdev->base,CIF_CIF_INTSTAT,0x01);  /* clear vip interrupte single  */
+        /* 
+        * Cif fill FRM0 and FRM1 in turn, the frame which status bit is set without videobuf 
+        * is parked by driver, so it isn't a completed frame.
+        */
+        first = pcdev->frame_next;
+        for (i=0; i<2; i++) {
+            frame = first^i;
+            if ((frm_status & (0x01<<frame)) && pcdev->active[frame]) {
+                rk_camera_frame_done(pcdev, frame);
+                pcdev->frame_next = frame^0x01;
             }
-            wake_up(&vb->done);
         }
+    } else if (frm_status & 0x01) {
+        /* ddl@rock-chps.com : Current VIP is run in One Frame Mode, Frame 1 is validate */
+        write_cif_reg(pcdev->base,CIF_CIF_INTSTAT,0x01);  /* clear vip interrupte single  */
+        rk_camera_frame_done(pcdev, 0);
     }
 
-end:
     if((reg_cifctrl & ENABLE_CAPTURE) == 0)
         write_cif_reg(pcdev->base,CIF_CIF_CTRL, (reg_cifctrl | ENABLE_CAPTURE));
     return IRQ_HANDLED;
@@ -1486,8 +2358,10 @@ static irqreturn_t rk_camera_irq(int irq, void *data)
 {
     struct rk_camera_dev *pcdev = data;
     unsigned long reg_intstat;
+    ktime_t ts = ktime_get();
 
     spin_lock(&pcdev->lock);
+    pcdev->irqinfo.ts = ts;
 
     if(atomic_read(&pcdev->stop_cif) == true) {
         write_cif_reg(pcdev->base,CIF_CIF_INTSTAT,0xffffffff);
@@ -1495,6 +2369,7 @@ static irqreturn_t rk_camera_irq(int irq, void *data)
     }
 
     reg_intstat = read_cif_reg(pcdev->base,CIF_CIF_INTSTAT);
+    trace_rk_camera_irq(pcdev->hostid, reg_intstat, pcdev->irqinfo.cifirq_idx, pcdev->irqinfo.dmairq_idx);
 
     if (reg_intstat & 0x0200)
         rk_camera_cifirq(irq,data);
@@ -1545,16 +2420,13 @@ static void rk_videobuf_release(struct videobuf_queue *vq,
     rk_videobuf_free(vq, buf);
     
 #if CAMERA_VIDEOBUF_ARM_ACCESS
+    /* mapping is kept in vbmap for next REQBUFS */
+    mutex_lock(&pcdev->vbmap_lock);
     if ((pcdev->vbinfo) && (vb->i < pcdev->vbinfo_count)) {
         vb_info = pcdev->vbinfo + vb->i;
-        
-        if (vb_info->vir_addr) {
-            iounmap(vb_info->vir_addr);
-            release_mem_region(vb_info->phy_addr, vb_info->size);
-            memset(vb_info, 0x00, sizeof(struct rk29_camera_vbinfo));
-        }       
-		
+        memset(vb_info, 0x00, sizeof(struct rk29_camera_vbinfo));
 	}
+    mutex_unlock(&pcdev->vbmap_lock);
 #endif  
 }
 
@@ -1574,6 +2446,11 @@ static void rk_camera_init_videobuf(struct videobuf_queue *q,
 
     /* We must pass NULL as dev pointer, then all pci_* dma operations
      * transform to normal dma_* ones. */
+    /*
+     * videobuf2 and dma-buf aren't in this kernel, so there is no VIDIOC_EXPBUF here. vb->boff is the physical address
+     * of videobuf (V4L2_MEMORY_OVERLAY), buffer of vpu or display can be queued to capture without copy, and it is
+     * filled by cif directly when it needn't scale or crop(CAM_DIRECT_IS_EN).
+     */
     videobuf_queue_dma_contig_init(q,
                                    &rk_videobuf_ops,
                                    ici->v4l2_dev.dev, &pcdev->lock,
@@ -1648,7 +2525,7 @@ static int rk_camera_activate(struct rk_camera_dev *pcdev, struct soc_camera_dev
     /*
     * ddl@rock-chips.com : Cif clk control in rk_sensor_power which in rk_camera.c
     */
-    write_cif_reg(pcdev->base,CIF_CIF_CTRL,AXI_BURST_16|MODE_ONEFRAME|DISABLE_CAPTURE);   /* ddl@rock-chips.com : vip ahb burst 16 */
+    write_cif_reg(pcdev->base,CIF_CIF_CTRL,AXI_BURST_16|pcdev->work_mode|DISABLE_CAPTURE);   /* ddl@rock-chips.com : vip ahb burst 16 */
     write_cif_reg(pcdev->base,CIF_CIF_INTEN, 0x01);    //capture complete interrupt enable
     return 0;
 }
@@ -1671,7 +2548,6 @@ static int rk_camera_add_device(struct soc_camera_device *icd)
     struct device *control = to_soc_camera_control(icd);
     struct v4l2_subdev *sd;
     int ret,i,icd_catch;
-    struct rk_camera_frmivalenum *fival_list,*fival_nxt;
     struct v4l2_cropcap cropcap;
     struct v4l2_mbus_framefmt mf;
     const struct soc_camera_format_xlate *xlate = NULL;
@@ -1690,7 +2566,8 @@ static int rk_camera_add_device(struct soc_camera_device *icd)
 //    RKCAMERA_DG1("sizeimage %u\n", icd->sizeimage);
 
 	pcdev->frame_inval = RK_CAM_FRAME_INVAL_INIT;
-    pcdev->active = NULL;
+    pcdev->active[0] = NULL;
+    pcdev->active[1] = NULL;
     pcdev->icd = NULL;
 	pcdev->reginfo_suspend.Inval = Reg_Invalidate;
     pcdev->zoominfo.zoom_rate = 100;
@@ -1745,15 +2622,8 @@ static int rk_camera_add_device(struct soc_camera_device *icd)
         }
     }
     if (icd_catch == 0) {
-        fival_list = pcdev->icd_frmival[0].fival_list;
-        fival_nxt = fival_list;
-        while(fival_nxt != NULL) {
-            fival_nxt = fival_list->nxt;
-            kfree(fival_list);
-            fival_list = fival_nxt;
-        }
+        memset(pcdev->icd_frmival[0].fival_tbl, 0x00, sizeof(pcdev->icd_frmival[0].fival_tbl));
         pcdev->icd_frmival[0].icd = icd;
-        pcdev->icd_frmival[0].fival_list = kzalloc(sizeof(struct rk_camera_frmivalenum),GFP_KERNEL);
     }
 ebusy:
     mutex_unlock(&camera_lock);
@@ -1766,7 +2636,6 @@ static void rk_camera_remove_device(struct soc_camera_device *icd)
     struct rk_camera_dev *pcdev = ici->priv;
 	struct v4l2_subdev *sd = soc_camera_to_subdev(icd);
 #if CAMERA_VIDEOBUF_ARM_ACCESS    
-    struct rk29_camera_vbinfo *vb_info;
     unsigned int i;
 #endif 
 
@@ -1782,6 +2651,7 @@ static void rk_camera_remove_device(struct soc_camera_device *icd)
 		rk_camera_s_stream(icd,0);
 	} 
     v4l2_subdev_call(sd, core, ioctl, RK29_CAM_SUBDEV_DEACTIVATE,NULL);
+    pcdev->fmt_icd = NULL;
     //if stream off is not been executed,timer is running.
     if(pcdev->fps_timer.istarted){
          hrtimer_cancel(&pcdev->fps_timer.timer);
@@ -1794,26 +2664,29 @@ static void rk_camera_remove_device(struct soc_camera_device *icd)
 		kfree(pcdev->camera_work);
 		pcdev->camera_work = NULL;
 		pcdev->camera_work_count = 0;
-        INIT_LIST_HEAD(&pcdev->camera_work_queue);
+        pcdev->camera_work_free = NULL;
 	}
 	rk_camera_deactivate(pcdev);
 #if CAMERA_VIDEOBUF_ARM_ACCESS
+    mutex_lock(&pcdev->vbmap_lock);
     if (pcdev->vbinfo) {
-        vb_info = pcdev->vbinfo;
-        for (i=0; i<pcdev->vbinfo_count; i++) {
-            if (vb_info->vir_addr) {
-                iounmap(vb_info->vir_addr);
-                release_mem_region(vb_info->phy_addr, vb_info->size);
-                memset(vb_info, 0x00, sizeof(struct rk29_camera_vbinfo));
-            }
-            vb_info++;
-        }
 		kfree(pcdev->vbinfo);
 		pcdev->vbinfo = NULL;
 		pcdev->vbinfo_count = 0;
 	}
+    for (i=0; i<RK_CAM_VBMAP_NUM; i++) {
+        rk_camera_vbmap_put(&pcdev->vbmap[i]);
+    }
+    mutex_unlock(&pcdev->vbmap_lock);
 #endif
-	pcdev->active = NULL;
+	pcdev->active[0] = NULL;
+	pcdev->active[1] = NULL;
+    down(&pcdev->zoominfo.sem);
+    rk_camera_scale_coeff_free(&pcdev->zoominfo);
+#if RK_CAM_SCALE_CROP_RGA_EN
+    rk_camera_rga_session_deinit(pcdev);
+#endif
+    up(&pcdev->zoominfo.sem);
     pcdev->icd = NULL;
     pcdev->icd_cb.sensor_cb = NULL;
 	pcdev->reginfo_suspend.Inval = Reg_Invalidate;
@@ -2063,19 +2936,44 @@ static void rk_camera_setup_format(struct soc_camera_device *icd, __u32 host_pix
             break;
     }
 
+    pcdev->work_mode = pingpong ? MODE_PINGPONG : MODE_ONEFRAME;
+    pcdev->frame_next = 0;
+
+    /*
+    * cif registers are read back, cif still keeps this format which is set up for this icd, its sensor isn't
+    * inited again since then (e.g. VIDIOC_S_FMT again before stream on), and the last stream hasn't error,
+    * so sensor output needn't wait and cif needn't reset.
+    */
+    cif_crop = (rect->left+ (rect->top<<16));
+    cif_fs	= ((rect->width ) + (rect->height<<16));
+    if ((pcdev->fmt_icd == icd)
+        && ((read_cif_reg(pcdev->base,CIF_CIF_CTRL) & ~ENABLE_CAPTURE) == (AXI_BURST_16|pcdev->work_mode|DISABLE_CAPTURE))
+        && (read_cif_reg(pcdev->base,CIF_CIF_INTEN) == (0x01|0x200))
+        && (read_cif_reg(pcdev->base,CIF_CIF_FOR) == cif_fmt_val)
+        && (read_cif_reg(pcdev->base,CIF_CIF_CROP) == cif_crop)
+        && (read_cif_reg(pcdev->base,CIF_CIF_SET_SIZE) == cif_fs)
+        && (read_cif_reg(pcdev->base,CIF_CIF_VIR_LINE_WIDTH) == rect->width)
+        && (read_cif_reg(pcdev->base,CIF_CIF_SCL_CTRL) == 0x10)
+        && (pcdev->irqinfo.cifirq_abnormal_idx == pcdev->irqinfo.cifreset_abnormal_idx)) {
+        write_cif_reg(pcdev->base,CIF_CIF_INTSTAT,0xFFFFFFFF); 
+        write_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS,  0x00000003);
+        RKCAMERA_DG1("CIF format is unchanged, CIF_CIF_CROP:0x%x  CIF_CIF_FS:0x%x  CIF_CIF_FOR:0x%x\n",cif_crop,cif_fs,cif_fmt_val);
+        return;
+    }
+
     mdelay(100);
     rk_camera_cif_reset(pcdev,true);
-    
-    write_cif_reg(pcdev->base,CIF_CIF_CTRL,AXI_BURST_16|MODE_ONEFRAME|DISABLE_CAPTURE);   /* ddl@rock-chips.com : vip ahb burst 16 */
+    pcdev->fmt_icd = icd;
+
+    write_cif_reg(pcdev->base,CIF_CIF_CTRL,AXI_BURST_16|pcdev->work_mode|DISABLE_CAPTURE);   /* ddl@rock-chips.com : vip ahb burst 16 */
     write_cif_reg(pcdev->base,CIF_CIF_INTEN, 0x01|0x200);    //capture complete interrupt enable
 
     write_cif_reg(pcdev->base,CIF_CIF_FOR,cif_fmt_val);         /* ddl@rock-chips.com: VIP capture mode and capture format must be set before FS register set */
 
     write_cif_reg(pcdev->base,CIF_CIF_INTSTAT,0xFFFFFFFF); 
-    if((read_cif_reg(pcdev->base,CIF_CIF_CTRL) & MODE_PINGPONG)
-		||(read_cif_reg(pcdev->base,CIF_CIF_CTRL) & MODE_LINELOOP)) {
+    if(read_cif_reg(pcdev->base,CIF_CIF_CTRL) & MODE_LINELOOP) {
 	    BUG();	
-    } else{ // this is one frame mode
+    } else{ // one frame mode and pingpong mode
 	    cif_crop = (rect->left+ (rect->top<<16));
 	    cif_fs	= ((rect->width ) + (rect->height<<16));
 	}
@@ -2096,6 +2994,10 @@ static int rk_camera_get_formats(struct soc_camera_device *icd, unsigned int idx
 {
     struct v4l2_subdev *sd = soc_camera_to_subdev(icd);
     struct device *dev = icd->dev.parent;
+#if RK_CAM_SCALE_CROP_RGA_EN
+    struct soc_camera_host *ici = to_soc_camera_host(dev);
+    struct rk_camera_dev *pcdev;
+#endif
     int formats = 0, ret;
 	enum v4l2_mbus_pixelcode code;
 	const struct soc_mbus_pixelfmt *fmt;
@@ -2114,6 +3016,9 @@ static int rk_camera_get_formats(struct soc_camera_device *icd, unsigned int idx
     ret = rk_camera_try_bus_param(icd, fmt->bits_per_sample);
     if (ret < 0)
         return 0;
+#if RK_CAM_SCALE_CROP_RGA_EN
+    pcdev = ici->priv;
+#endif
 
     switch (code) {
         case V4L2_MBUS_FMT_UYVY8_2X8:
@@ -2122,7 +3027,6 @@ static int rk_camera_get_formats(struct soc_camera_device *icd, unsigned int idx
         case V4L2_MBUS_FMT_VYUY8_2X8:
         {
         
-#if (CONFIG_CAMERA_SCALE_CROP_MACHINE != RK_CAM_SCALE_CROP_RGA)
     		formats++;
     		if (xlate) {
     			xlate->host_fmt = &rk_camera_formats[0];
@@ -2158,8 +3062,9 @@ static int rk_camera_get_formats(struct soc_camera_device *icd, unsigned int idx
     			dev_dbg(dev, "Providing format %s using code %d\n",
     				rk_camera_formats[3].name,code);
     		}
-    		break;	
-#else 
+#if RK_CAM_SCALE_CROP_RGA_EN
+            if (pcdev->rga_en == false)
+                break;
     		formats++;
     		if (xlate) {
     			xlate->host_fmt = &rk_camera_formats[4];
@@ -2176,8 +3081,8 @@ static int rk_camera_get_formats(struct soc_camera_device *icd, unsigned int idx
     			dev_dbg(dev, "Providing format %s using code %d\n",
     				rk_camera_formats[5].name,code);
     		}
-			break;		
 #endif			
+			break;		
         }
         default:
             break;
@@ -2268,6 +3173,7 @@ static int rk_camera_set_fmt(struct soc_camera_device *icd,
     struct v4l2_rect rect;
     int ret,usr_w,usr_h,sensor_w,sensor_h;
     int stream_on = 0;
+    unsigned long flags;
     int ratio, bounds_aspect;
 	v4l2_std_id stdid;
 	usr_w = pix->width;
@@ -2286,8 +3192,15 @@ static int rk_camera_set_fmt(struct soc_camera_device *icd,
     if (pcdev->icd_init == 0) {
         v4l2_subdev_call(sd, core, init, 0);
         pcdev->icd_init = 1;
+        pcdev->fmt_icd = NULL;
         return 0;
     }
+#endif
+#if RK_CAM_SCALE_CROP_SEL
+    /* CROP_ALIGN_BYTES depend on the engine, so select it first */
+    down(&pcdev->zoominfo.sem);
+    rk_camera_scale_crop_select(pcdev, pix->pixelformat, usr_w, usr_h);
+    up(&pcdev->zoominfo.sem);
 #endif
     stream_on = read_cif_reg(pcdev->base,CIF_CIF_CTRL);
     if (stream_on & ENABLE_CAPTURE)
@@ -2447,10 +3360,12 @@ static int rk_camera_set_fmt(struct soc_camera_device *icd,
         pcdev->zoominfo.vir_width = pcdev->host_width;
         pcdev->zoominfo.vir_height = pcdev->host_height;
 #endif
+        rk_camera_scale_coeff_update(&pcdev->zoominfo, usr_w);
         up(&pcdev->zoominfo.sem);
 
         /* ddl@rock-chips.com: IPP work limit check */
-        if ((pcdev->zoominfo.a.c.width != usr_w) || (pcdev->zoominfo.a.c.height != usr_h)) {
+        if ((pcdev->scale_engine == RK_CAM_ENGINE_IPP) 
+            && ((pcdev->zoominfo.a.c.width != usr_w) || (pcdev->zoominfo.a.c.height != usr_h))) {
             if (usr_w > 0x7f0) {
                 if (((usr_w>>1)&0x3f) && (((usr_w>>1)&0x3f) <= 8)) {
                     RKCAMERA_TR("IPP Destination resolution(%dx%d, ((%d div 1) mod 64)=%d is <= 8)",usr_w,usr_h, usr_w, (int)((usr_w>>1)&0x3f));
@@ -2486,6 +3401,11 @@ static int rk_camera_set_fmt(struct soc_camera_device *icd,
     	icd->current_fmt = xlate;   
         pcdev->icd_width = mf.width;
         pcdev->icd_height = mf.height;
+
+        /* format is negotiated again after source change */
+        spin_lock_irqsave(&pcdev->lock,flags);
+        pcdev->src_change = 0;
+        spin_unlock_irqrestore(&pcdev->lock,flags);
     }
 
 RK_CAMERA_SET_FMT_END:
@@ -2634,18 +3554,60 @@ static int rk_camera_reqbufs(struct soc_camera_device *icd,
 static unsigned int rk_camera_poll(struct file *file, poll_table *pt)
 {
     struct soc_camera_device *icd = file->private_data;
+    struct soc_camera_host *ici = to_soc_camera_host(icd->dev.parent);
+    struct rk_camera_dev *pcdev = ici->priv;
     struct rk_camera_buffer *buf;
+    unsigned int mask = 0;
+
+    /* videobuf_dqbuf always return the first vb in stream, so it is checked after wait */
+    poll_wait(file, &pcdev->done_wq, pt);
+
+    /* source is changed, app should get it by V4L2_CID_RK_CAM_SOURCE_CHANGE and set format again */
+    if ((pcdev->icd == icd) && ACCESS_ONCE(pcdev->src_change))
+        mask |= POLLPRI;
+
+    /* as videobuf_poll_stream, there is no videobuf which will be done */
+    if (list_empty(&icd->vb_vidq.stream) || !icd->vb_vidq.streaming)
+        return mask|POLLERR;
 
     buf = list_entry(icd->vb_vidq.stream.next, struct rk_camera_buffer,
                     vb.stream);
 
-    poll_wait(file, &buf->vb.done, pt);
-
     if (buf->vb.state == VIDEOBUF_DONE ||
-            buf->vb.state == VIDEOBUF_ERROR)
-        return POLLIN|POLLRDNORM;
+            buf->vb.state == VIDEOBUF_ERROR) {
+        rk_camera_latency_dq(pcdev, &buf->vb);
+        mask |= POLLIN|POLLRDNORM;
+    }
 
-    return 0;
+    return mask;
+}
+
+/*
+ * soc_camera hasn't v4l2 event, so source change notified by sensor is kept in src_change,
+ * poll returns POLLPRI until app reads V4L2_CID_RK_CAM_SOURCE_CHANGE or sets format.
+ */
+static void rk_camera_notify(struct v4l2_subdev *sd, unsigned int notification, void *arg)
+{
+    struct soc_camera_host *ici = container_of(sd->v4l2_dev, struct soc_camera_host, v4l2_dev);
+    struct rk_camera_dev *pcdev = ici->priv;
+    unsigned long flags;
+    u32 changes;
+
+    switch (notification)
+    {
+        case RK_CAM_NOTIFY_SOURCE_CHANGE:
+        {
+            changes = arg ? *(u32*)arg : RK_CAM_SRC_CH_RESOLUTION;
+            spin_lock_irqsave(&pcdev->lock,flags);
+            pcdev->src_change |= changes;
+            spin_unlock_irqrestore(&pcdev->lock,flags);
+            RKCAMERA_DG1("%s source change 0x%x\n", sd->name, changes);
+            wake_up_all(&pcdev->done_wq);
+            break;
+        }
+        default:
+            break;
+    }
 }
 /*
 *card:  sensor name _ facing _ device index - orientation _ fov horizontal _ fov vertical
@@ -2720,6 +3682,7 @@ static int rk_camera_suspend(struct soc_camera_device *icd, pm_message_t state)
 		
 		pcdev->reginfo_suspend.Inval = Reg_Validate;
 		rk_camera_deactivate(pcdev);
+		pcdev->fmt_icd = NULL;
 
 		RKCAMERA_DG1("%s Enter Success...\n", __FUNCTION__);
 	} else {
@@ -2748,7 +3711,9 @@ static int rk_camera_resume(struct soc_camera_device *icd)
 			write_cif_reg(pcdev->base,CIF_CIF_FOR, pcdev->reginfo_suspend.cifFmt);
 			write_cif_reg(pcdev->base,CIF_CIF_VIR_LINE_WIDTH,pcdev->reginfo_suspend.cifVirWidth);
 			write_cif_reg(pcdev->base,CIF_CIF_SCL_CTRL, pcdev->reginfo_suspend.cifScale);
-			rk_videobuf_capture(pcdev->active,pcdev);
+			rk_videobuf_capture(pcdev->active[0],pcdev,0);
+			if (CAM_PINGPONG_IS_EN())
+				rk_videobuf_capture(pcdev->active[1],pcdev,1);
 			rk_camera_s_stream(icd, 1);
 			pcdev->reginfo_suspend.Inval = Reg_Invalidate;
 		} else {
@@ -2785,6 +3750,8 @@ static void rk_camera_reinit_work(struct work_struct *work)
         return;
     sd = soc_camera_to_subdev(pcdev->icd);
     tmp_soc_cam_link = to_soc_camera_link(pcdev->icd);
+    /* cif is reset and sensor may be inited again, cif format must be set up completely in next stream */
+    pcdev->fmt_icd = NULL;
 	//dump regs
 	{
 		RKCAMERA_TR("CIF_CIF_CTRL = 0x%x\n",read_cif_reg(pcdev->base,CIF_CIF_CTRL));
@@ -2855,18 +3822,44 @@ static void rk_camera_reinit_work(struct work_struct *work)
             }
         }
         spin_unlock_irqrestore(pcdev->video_vq->irqlock, flags); 
+        wake_up_all(&pcdev->done_wq);
     }else{
         RKCAMERA_TR("video queue has somthing wrong !!\n");
     }
 
 	RKCAMERA_TR("the %d reinit times ,wake up video buffers!\n ",pcdev->reinit_times);
 }
+/*
+ * Return the entry of (pixfmt, width, height), or NULL if it isn't recorded. If alloc, a free entry is returned 
+ * for unrecorded one, and the home entry is replaced when table is full.
+ * Locking: Caller holds pcdev->lock
+ */
+static struct rk_camera_frmivalenum *rk_camera_frmival_lookup(struct rk_camera_frmivalinfo *info,
+                                            __u32 pixfmt, __u32 width, __u32 height, bool alloc)
+{
+    struct rk_camera_frmivalenum *entry;
+    unsigned int i,home;
+
+    home = hash_32(pixfmt ^ (width<<16) ^ height, RK_CAM_FRMIVAL_BITS);
+    for (i=0; i<RK_CAM_FRMIVAL_NUM; i++) {
+        entry = &info->fival_tbl[(home+i)&(RK_CAM_FRMIVAL_NUM-1)];
+        if (entry->fival.discrete.denominator == 0)
+            return alloc ? entry : NULL;
+        if ((entry->fival.pixel_format == pixfmt) && (entry->fival.width == width) 
+            && (entry->fival.height == height))
+            return entry;
+    }
+    
+    return alloc ? &info->fival_tbl[home] : NULL;
+}
 static enum hrtimer_restart rk_camera_fps_func(struct hrtimer *timer)
 {
-    struct rk_camera_frmivalenum *fival_nxt=NULL,*fival_pre=NULL, *fival_rec=NULL;
+    struct rk_camera_frmivalenum *fival_rec=NULL;
+    struct rk_camera_frmivalinfo *fival_info=NULL;
 	struct rk_camera_timer *fps_timer = container_of(timer, struct rk_camera_timer, timer);
 	struct rk_camera_dev *pcdev = fps_timer->pcdev;
-    int rec_flag,i;
+    unsigned long flags;
+    int i;
    // static unsigned int last_fps = 0;
     struct soc_camera_link *tmp_soc_cam_link;
     tmp_soc_cam_link = to_soc_camera_link(pcdev->icd);
@@ -2880,63 +3873,41 @@ static enum hrtimer_restart rk_camera_fps_func(struct hrtimer *timer)
 		pcdev->reinit_times++;
 		queue_work(pcdev->camera_wq,&(pcdev->camera_reinit_work.work));
 		
-	} else if(!pcdev->timer_get_fps) {
-	    pcdev->timer_get_fps = true;
+	} else {
 	    for (i=0; i<2; i++) {
             if (pcdev->icd == pcdev->icd_frmival[i].icd) {
-                fival_nxt = pcdev->icd_frmival[i].fival_list;                
+                fival_info = &pcdev->icd_frmival[i];
             }
         }
         
-        rec_flag = 0;
-        fival_pre = fival_nxt;
-        while (fival_nxt != NULL) {
-
-            RKCAMERA_DG1("%s %c%c%c%c %dx%d framerate : %d/%d\n", dev_name(&pcdev->icd->dev), 
-                fival_nxt->fival.pixel_format & 0xFF, (fival_nxt->fival.pixel_format >> 8) & 0xFF,
-			    (fival_nxt->fival.pixel_format >> 16) & 0xFF, (fival_nxt->fival.pixel_format >> 24),
-			    fival_nxt->fival.width, fival_nxt->fival.height, fival_nxt->fival.discrete.denominator,
-			    fival_nxt->fival.discrete.numerator);
-            
-            if (((fival_nxt->fival.pixel_format == pcdev->pixfmt) 
-                && (fival_nxt->fival.height == pcdev->icd->user_height)
-                && (fival_nxt->fival.width == pcdev->icd->user_width))
-                || (fival_nxt->fival.discrete.denominator == 0)) {
-
-                if (fival_nxt->fival.discrete.denominator == 0) {
-                    fival_nxt->fival.index = 0;
-                    fival_nxt->fival.width = pcdev->icd->user_width;
-                    fival_nxt->fival.height= pcdev->icd->user_height;
-                    fival_nxt->fival.pixel_format = pcdev->pixfmt;
-                    fival_nxt->fival.discrete.denominator = pcdev->frame_interval;
-                    fival_nxt->fival.reserved[1] = (pcdev->icd_width<<16)
-                                                    |(pcdev->icd_height);
-                    fival_nxt->fival.discrete.numerator = 1000000;
-                    fival_nxt->fival.type = V4L2_FRMIVAL_TYPE_DISCRETE;
-                }
-                rec_flag = 1;
-                fival_rec = fival_nxt;
+        /* table is allocated in probe, nothing is allocated in hrtimer */
+        if (fival_info && pcdev->frame_interval) {
+            spin_lock_irqsave(&pcdev->lock,flags);
+            fival_rec = rk_camera_frmival_lookup(fival_info, pcdev->pixfmt, pcdev->icd->user_width,
+                                                    pcdev->icd->user_height, true);
+            if ((fival_rec->fival.discrete.denominator == 0)
+                || (fival_rec->fival.pixel_format != pcdev->pixfmt)
+                || (fival_rec->fival.width != pcdev->icd->user_width)
+                || (fival_rec->fival.height != pcdev->icd->user_height)) {
+                fival_rec->fival.index = 0;
+                fival_rec->fival.width = pcdev->icd->user_width;
+                fival_rec->fival.height= pcdev->icd->user_height;
+                fival_rec->fival.pixel_format = pcdev->pixfmt;
+                fival_rec->fival.reserved[1] = (pcdev->icd_width<<16)
+                                                |(pcdev->icd_height);
+                fival_rec->fival.discrete.numerator = 1000000;
+                fival_rec->fival.type = V4L2_FRMIVAL_TYPE_DISCRETE;
             }
-            fival_pre = fival_nxt;
-            fival_nxt = fival_nxt->nxt;            
-        }
+            /* entry follows the measured rate by every fps timer while streaming */
+            fival_rec->fival.discrete.denominator = pcdev->frame_interval;
+            spin_unlock_irqrestore(&pcdev->lock,flags);
 
-        if ((rec_flag == 0) && fival_pre) {
-            fival_pre->nxt = kzalloc(sizeof(struct rk_camera_frmivalenum), GFP_ATOMIC);
-            if (fival_pre->nxt != NULL) {
-                fival_pre->nxt->fival.index = fival_pre->fival.index++;
-                fival_pre->nxt->fival.width = pcdev->icd->user_width;
-                fival_pre->nxt->fival.height= pcdev->icd->user_height;
-                fival_pre->nxt->fival.pixel_format = pcdev->pixfmt;
-
-                fival_pre->nxt->fival.discrete.denominator = pcdev->frame_interval;
-                fival_pre->nxt->fival.reserved[1] = (pcdev->icd_width<<16)
-                                                    |(pcdev->icd_height);
-                fival_pre->nxt->fival.discrete.numerator = 1000000;
-                fival_pre->nxt->fival.type = V4L2_FRMIVAL_TYPE_DISCRETE;
-                rec_flag = 1;
-                fival_rec = fival_pre->nxt;
-            }
+            RKCAMERA_DG1("%s %c%c%c%c %dx%d framerate : %d/%d\n", dev_name(&pcdev->icd->dev), 
+                fival_rec->fival.pixel_format & 0xFF, (fival_rec->fival.pixel_format >> 8) & 0xFF,
+			    (fival_rec->fival.pixel_format >> 16) & 0xFF, (fival_rec->fival.pixel_format >> 24),
+			    fival_rec->fival.width, fival_rec->fival.height, fival_rec->fival.discrete.denominator,
+			    fival_rec->fival.discrete.numerator);
+            pcdev->timer_get_fps = true;
         }
 	}
 
@@ -2967,6 +3938,9 @@ static int rk_camera_s_stream(struct soc_camera_device *icd, int enable)
 		pcdev->fps = 0;
         pcdev->last_fps = 0;
         pcdev->frame_interval = 0;
+        pcdev->frame_interval_avg = 0;
+        pcdev->frame_jitter = 0;
+        pcdev->frame_last = ktime_set(0,0);
 		hrtimer_cancel(&(pcdev->fps_timer.timer));
 		pcdev->fps_timer.pcdev = pcdev;
         pcdev->timer_get_fps = false;
@@ -2978,6 +3952,12 @@ static int rk_camera_s_stream(struct soc_camera_device *icd, int enable)
         pcdev->irqinfo.cifirq_normal_idx = 0;
         pcdev->irqinfo.cifirq_abnormal_idx = 0;
         pcdev->irqinfo.dmairq_idx = 0;
+        pcdev->irqinfo.capture_idx = 0;
+        pcdev->irqinfo.cifreset_idx = 0;
+        pcdev->irqinfo.cifreset_abnormal_idx = 0;
+        pcdev->frame_next = 0;
+        pcdev->frame_direct = 0;
+        rk_camera_latency_reset(pcdev);
         
 		cif_ctrl_val |= ENABLE_CAPTURE;
         write_cif_reg(pcdev->base,CIF_CIF_CTRL, cif_ctrl_val);
@@ -2997,22 +3977,60 @@ static int rk_camera_s_stream(struct soc_camera_device *icd, int enable)
         atomic_set(&pcdev->stop_cif,true);
     	spin_unlock_irqrestore(&pcdev->lock, flags);
 		flush_workqueue((pcdev->camera_wq));
+        /* no more videobuf is done by cif, poll mustn't sleep on done_wq through stream off */
+        wake_up_all(&pcdev->done_wq);
+        RKCAMERA_DG1("capture %ld frames, cif soft reset %ld times in capture, cif irq: %ld, dma irq: %ld, work pool empty: %ld\n",
+                    pcdev->irqinfo.capture_idx,pcdev->irqinfo.cifreset_idx,pcdev->irqinfo.cifirq_idx,pcdev->irqinfo.dmairq_idx,
+                    pcdev->latency.drop_idx);
 	}
     //must be reinit,or will be somthing wrong in irq process.
     if(enable == false) {
-        pcdev->active = NULL;
+        pcdev->active[0] = NULL;
+        pcdev->active[1] = NULL;
         INIT_LIST_HEAD(&pcdev->capture);
     }
 	RKCAMERA_DG1("s_stream: enable : 0x%x , CIF_CIF_CTRL = 0x%x\n",enable,read_cif_reg(pcdev->base,CIF_CIF_CTRL));
 	return 0;
 }
+/*
+ * timeperframe is the measured frame interval when streaming, jitter is in debugfs rk_cam_cifX_latency.
+ */
+static int rk_camera_get_parm(struct soc_camera_device *icd, struct v4l2_streamparm *a)
+{
+    struct soc_camera_host *ici = to_soc_camera_host(icd->dev.parent);
+    struct rk_camera_dev *pcdev = ici->priv;
+    struct v4l2_subdev *sd = soc_camera_to_subdev(icd);
+    unsigned int interval;
+    unsigned long flags;
+    int ret;
+
+    if (a->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+        return -EINVAL;
+
+    ret = v4l2_subdev_call(sd, video, g_parm, a);
+    if ((ret < 0) && (ret != -ENOIOCTLCMD))
+        return ret;
+
+    spin_lock_irqsave(&pcdev->lock,flags);
+    interval = pcdev->frame_interval_avg;
+    spin_unlock_irqrestore(&pcdev->lock,flags);
+
+    if ((pcdev->icd == icd) && (interval >= (1<<4))) {
+        a->parm.capture.capability |= V4L2_CAP_TIMEPERFRAME;
+        a->parm.capture.timeperframe.numerator = interval>>4;
+        a->parm.capture.timeperframe.denominator = 1000000;
+    }
+    return 0;
+}
 int rk_camera_enum_frameintervals(struct soc_camera_device *icd, struct v4l2_frmivalenum *fival)
 {
     struct soc_camera_host *ici = to_soc_camera_host(icd->dev.parent);
     struct rk_camera_dev *pcdev = ici->priv;
     struct v4l2_subdev *sd = soc_camera_to_subdev(icd);
-    struct rk_camera_frmivalenum *fival_list = NULL;
+    struct rk_camera_frmivalenum *fival_rec = NULL;
+    struct rk_camera_frmivalinfo *fival_info = NULL;
     struct v4l2_frmivalenum *fival_head = NULL;
+    unsigned long flags;
     struct rkcamera_platform_data *new_camera;
     int i,ret = 0,index;
     const struct soc_camera_format_xlate *xlate;
@@ -3023,30 +4041,24 @@ int rk_camera_enum_frameintervals(struct soc_camera_device *icd, struct v4l2_frm
     if ((fival->index & 0xff000000) == 0xff000000) {   /* ddl@rock-chips.com: detect framerate */ 
         for (i=0; i<2; i++) {
             if (pcdev->icd_frmival[i].icd == icd) {
-                fival_list = pcdev->icd_frmival[i].fival_list;            
+                fival_info = &pcdev->icd_frmival[i];            
             }
         }
         
-        if (fival_list != NULL) {
-            i = 0;
-            while (fival_list != NULL) {
-                if ((fival->pixel_format == fival_list->fival.pixel_format)
-                    && (fival->height == fival_list->fival.height) 
-                    && (fival->width == fival_list->fival.width)) {
-                    if (i == index)
-                        break;
-                    i++;
-                }                
-                fival_list = fival_list->nxt;                
-            }
-            
-            if ((i==index) && (fival_list != NULL)) {
-                memcpy(fival, &fival_list->fival, sizeof(struct v4l2_frmivalenum));
-            } else {
-                ret = -EINVAL;
+        if (fival_info != NULL) {
+            /* only one interval is recorded for each format and size */
+            ret = -EINVAL;
+            if (index == 0) {
+                spin_lock_irqsave(&pcdev->lock,flags);
+                fival_rec = rk_camera_frmival_lookup(fival_info, fival->pixel_format, fival->width, fival->height, false);
+                if (fival_rec) {
+                    memcpy(fival, &fival_rec->fival, sizeof(struct v4l2_frmivalenum));
+                    ret = 0;
+                }
+                spin_unlock_irqrestore(&pcdev->lock,flags);
             }
         } else {
-            RKCAMERA_TR("%s: fival_list is NULL\n",__FUNCTION__);
+            RKCAMERA_TR("%s: fival_info is NULL\n",__FUNCTION__);
             ret = -EINVAL;
         }
     }  else {  
@@ -3176,13 +4188,19 @@ static int rk_camera_set_digit_zoom(struct soc_camera_device *icd,
     pcdev->zoominfo.a.c.height = a.c.height;
     pcdev->zoominfo.vir_width = pcdev->zoominfo.a.c.width;
     pcdev->zoominfo.vir_height = pcdev->zoominfo.a.c.height;
+    rk_camera_scale_coeff_update(&pcdev->zoominfo, icd->user_width);
     pcdev->frame_inval = 1;
     write_cif_reg(pcdev->base,CIF_CIF_CROP, (a.c.left + (a.c.top<<16)));
     write_cif_reg(pcdev->base,CIF_CIF_SET_SIZE, ((a.c.width ) + (a.c.height<<16)));
     write_cif_reg(pcdev->base,CIF_CIF_VIR_LINE_WIDTH, a.c.width);
-    write_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS,  0x00000002);//frame1 has been ready to receive data,frame 2 is not used
-    if(pcdev->active)
-        rk_videobuf_capture(pcdev->active,pcdev);
+    if (CAM_PINGPONG_IS_EN())
+        write_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS,  0x00000003);//frame which have videobuf is released in rk_videobuf_capture
+    else
+        write_cif_reg(pcdev->base,CIF_CIF_FRAME_STATUS,  0x00000002);//frame1 has been ready to receive data,frame 2 is not used
+    if(pcdev->active[0])
+        rk_videobuf_capture(pcdev->active[0],pcdev,0);
+    if(CAM_PINGPONG_IS_EN() && pcdev->active[1])
+        rk_videobuf_capture(pcdev->active[1],pcdev,1);
     if(tmp_cifctrl & ENABLE_CAPTURE)
         write_cif_reg(pcdev->base,CIF_CIF_CTRL, (tmp_cifctrl | ENABLE_CAPTURE));
     up(&pcdev->zoominfo.sem);
@@ -3206,6 +4224,7 @@ static int rk_camera_set_digit_zoom(struct soc_camera_device *icd,
     pcdev->zoominfo.a.c.left = a.c.left;
     pcdev->zoominfo.vir_width = pcdev->host_width;
     pcdev->zoominfo.vir_height= pcdev->host_height;
+    rk_camera_scale_coeff_update(&pcdev->zoominfo, icd->user_width);
     up(&pcdev->zoominfo.sem);
     
     RKCAMERA_DG1("zoom_rate:%d (%dx%d at (%d,%d)-> %dx%d)\n", zoom_rate,a.c.width, a.c.height, a.c.left, a.c.top, icd->user_width, icd->user_height );
@@ -3259,6 +4278,9 @@ static int rk_camera_set_ctrl(struct soc_camera_device *icd,
             }
 			break;
 		}
+		case V4L2_CID_RK_CAM_SOURCE_CHANGE:
+			ret = -EACCES;
+			break;
 		default:
 			ret = -ENOIOCTLCMD;
 			break;
@@ -3266,6 +4288,35 @@ static int rk_camera_set_ctrl(struct soc_camera_device *icd,
 rk_camera_set_ctrl_end:
 	return ret;
 }
+static int rk_camera_get_ctrl(struct soc_camera_device *icd,
+								struct v4l2_control *sctrl)
+{
+	struct soc_camera_host *ici = to_soc_camera_host(icd->dev.parent);
+    struct rk_camera_dev *pcdev = ici->priv;
+    unsigned long flags;
+    int ret = 0;
+
+	switch (sctrl->id)
+	{
+		case V4L2_CID_RK_CAM_SOURCE_CHANGE:
+		{
+            /* read and clear */
+            spin_lock_irqsave(&pcdev->lock,flags);
+            if (pcdev->icd == icd) {
+                sctrl->value = pcdev->src_change;
+                pcdev->src_change = 0;
+            } else {
+                sctrl->value = 0;
+            }
+            spin_unlock_irqrestore(&pcdev->lock,flags);
+			break;
+		}
+		default:
+			ret = -ENOIOCTLCMD;
+			break;
+	}
+	return ret;
+}
 
 static struct soc_camera_host_ops rk_soc_camera_host_ops =
 {
@@ -3285,10 +4336,12 @@ static struct soc_camera_host_ops rk_soc_camera_host_ops =
     .init_videobuf	= rk_camera_init_videobuf,
     .reqbufs	= rk_camera_reqbufs,
     .poll		= rk_camera_poll,
+    .get_parm	= rk_camera_get_parm,
     .querycap	= rk_camera_querycap,
     .set_bus_param	= rk_camera_set_bus_param,
     .s_stream = rk_camera_s_stream,   /* ddl@rock-chips.com : Add stream control for host */
     .set_ctrl = rk_camera_set_ctrl,
+    .get_ctrl = rk_camera_get_ctrl,
     .controls = rk_camera_controls,
     .num_controls = ARRAY_SIZE(rk_camera_controls)
 };
@@ -3365,7 +4418,6 @@ static int rk_camera_probe(struct platform_device *pdev)
 {
     struct rk_camera_dev *pcdev;
     struct resource *res;
-    struct rk_camera_frmivalenum *fival_list,*fival_nxt;
     struct rk29camera_mem_res *meminfo_ptr,*meminfo_ptrr;
     int irq,i;
     int err = 0;
@@ -3469,13 +4521,15 @@ static int rk_camera_probe(struct platform_device *pdev)
     pcdev->vipmem_virbase = meminfo_ptr->vbase;
 	
     INIT_LIST_HEAD(&pcdev->capture);
-    INIT_LIST_HEAD(&pcdev->camera_work_queue);
+    pcdev->camera_work_free = NULL;
     spin_lock_init(&pcdev->lock);
-    spin_lock_init(&pcdev->camera_work_lock);
 
     memset(&pcdev->cropinfo.c,0x00,sizeof(struct v4l2_rect));
     spin_lock_init(&pcdev->cropinfo.lock);
     sema_init(&pcdev->zoominfo.sem,1);
+#if CAMERA_VIDEOBUF_ARM_ACCESS
+    mutex_init(&pcdev->vbmap_lock);
+#endif
 
     /*
      * Request the regions.
@@ -3519,20 +4573,42 @@ static int rk_camera_probe(struct platform_device *pdev)
         goto exit_free_irq;
     }
 
+    /* band work mustn't wait behind capture work which is blocked on zoominfo.sem */
+    if(IS_CIF0()) {
+    	pcdev->scale_wq = create_workqueue("rk_cam_scale_cif0");
+    } else {
+    	pcdev->scale_wq = create_workqueue("rk_cam_scale_cif1");
+    }
+    if (pcdev->scale_wq == NULL) {
+        RKCAMERA_TR("%s(%d): Create scale workqueue failed, arm scale is only run on one cpu!\n",__FUNCTION__,__LINE__);
+    }
+    init_completion(&pcdev->scale_job.done);
+    for (i=0; i<RK_CAM_SCALE_BAND_MAX; i++) {
+        pcdev->scale_job.band[i].pcdev = pcdev;
+        INIT_WORK(&(pcdev->scale_job.band[i].work), rk_camera_scale_band_work);
+    }
+
 	pcdev->camera_reinit_work.pcdev = pcdev;
 	INIT_WORK(&(pcdev->camera_reinit_work.work), rk_camera_reinit_work);
 
     for (i=0; i<2; i++) {
         pcdev->icd_frmival[i].icd = NULL;
-        pcdev->icd_frmival[i].fival_list = kzalloc(sizeof(struct rk_camera_frmivalenum),GFP_KERNEL);
-        
+        memset(pcdev->icd_frmival[i].fival_tbl, 0x00, sizeof(pcdev->icd_frmival[i].fival_tbl));
     }
+    spin_lock_init(&pcdev->latency.lock);
+    init_waitqueue_head(&pcdev->done_wq);
+    pcdev->src_change = 0;
     pcdev->soc_host.drv_name	= RK29_CAM_DRV_NAME;
     pcdev->soc_host.ops		= &rk_soc_camera_host_ops;
     pcdev->soc_host.priv		= pcdev;
     pcdev->soc_host.v4l2_dev.dev	= &pdev->dev;
+    pcdev->soc_host.v4l2_dev.notify = rk_camera_notify;
     pcdev->soc_host.nr		= pdev->id;
 
+#if RK_CAM_SCALE_CROP_RGA_EN
+    /* rga is opt-in, it is latched here because RGB formats are provided by it */
+    pcdev->rga_en = (scale_crop == 2);
+#endif
     err = soc_camera_host_register(&pcdev->soc_host);
     if (err) {
         RKCAMERA_TR("%s(%d): soc_camera_host_register failed\n",__FUNCTION__,__LINE__);
@@ -3543,34 +4619,32 @@ static int rk_camera_probe(struct platform_device *pdev)
 	pcdev->fps_timer.timer.function = rk_camera_fps_func;
     pcdev->icd_cb.sensor_cb = NULL;
 
-#if (CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_IPP)
-    pcdev->icd_cb.scale_crop_cb = rk_camera_scale_crop_ipp;
-#elif (CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_ARM)
-    pcdev->icd_cb.scale_crop_cb = rk_camera_scale_crop_arm;
-#elif (CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_RGA)
-    pcdev->icd_cb.scale_crop_cb = rk_camera_scale_crop_rga;	
-#elif(CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_PP)
+    pcdev->latency.dbgfs = debugfs_create_file(IS_CIF0()?"rk_cam_cif0_latency":"rk_cam_cif1_latency", S_IRUGO,
+                                                NULL, pcdev, &rk_camera_latency_fops);
+
+#if(CONFIG_CAMERA_SCALE_CROP_MACHINE == RK_CAM_SCALE_CROP_PP)
 	pcdev->icd_cb.scale_crop_cb = rk_camera_scale_crop_pp; 
+    pcdev->scale_engine = RK_CAM_ENGINE_PP;
+#else
+    /* scale_crop_cb is selected again in rk_camera_set_fmt */
+    pcdev->icd_cb.scale_crop_cb = rk_camera_scale_crop_arm;
+    pcdev->scale_engine = RK_CAM_ENGINE_ARM;
+    pcdev->scale_probe = RK_CAM_ENGINE_NUM;
+    pcdev->crop_align = 0x0f;
 #endif
     return 0;
 
 exit_free_irq:
     
-    for (i=0; i<2; i++) {
-        fival_list = pcdev->icd_frmival[i].fival_list;
-        fival_nxt = fival_list;
-        while(fival_nxt != NULL) {
-            fival_nxt = fival_list->nxt;
-            kfree(fival_list);
-            fival_list = fival_nxt;
-        }
-    }
-    
     free_irq(pcdev->irqinfo.irq, pcdev);
 	if (pcdev->camera_wq) {
 		destroy_workqueue(pcdev->camera_wq);
 		pcdev->camera_wq = NULL;
 	}
+	if (pcdev->scale_wq) {
+		destroy_workqueue(pcdev->scale_wq);
+		pcdev->scale_wq = NULL;
+	}
 exit_reqirq:
     iounmap(pcdev->base);
 exit_ioremap_vip:
@@ -3603,26 +4677,19 @@ static int __devexit rk_camera_remove(struct platform_device *pdev)
 {
     struct rk_camera_dev *pcdev = platform_get_drvdata(pdev);
     struct resource *res;
-    struct rk_camera_frmivalenum *fival_list,*fival_nxt;
     struct rk29camera_mem_res *meminfo_ptr,*meminfo_ptrr;
-    int i;
     
+    debugfs_remove(pcdev->latency.dbgfs);
     free_irq(pcdev->irqinfo.irq, pcdev);
 
 	if (pcdev->camera_wq) {
 		destroy_workqueue(pcdev->camera_wq);
 		pcdev->camera_wq = NULL;
 	}
-
-    for (i=0; i<2; i++) {
-        fival_list = pcdev->icd_frmival[i].fival_list;
-        fival_nxt = fival_list;
-        while(fival_nxt != NULL) {
-            fival_nxt = fival_list->nxt;
-            kfree(fival_list);
-            fival_list = fival_nxt;
-        }
-    }
+	if (pcdev->scale_wq) {
+		destroy_workqueue(pcdev->scale_wq);
+		pcdev->scale_wq = NULL;
+	}
 
     soc_camera_host_unregister(&pcdev->soc_host);
 
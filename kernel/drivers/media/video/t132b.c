@@ -21,7 +21,10 @@
 #include <media/v4l2-chip-ident.h>
 #include <linux/mutex.h>
 #include <linux/delay.h>
+#include <linux/bitops.h>
+#include <linux/gpio.h>
 #include <media/soc_camera.h>
+#include <media/rk_camera_notify.h>
 #include <linux/platform_device.h>
 #include <mach/iomux.h>
 #include <mach/io.h>
@@ -58,7 +61,11 @@
 // for PX2 SDK V10
 #define T132B_CVBS_IN_DET 	RK30_PIN6_PA0
 #define T132B_YCRCB_IN_DET 	RK30_PIN0_PB7
+#define T132B_DET_DEBOUNCE_MS	20
+#define T132B_DET_RECHECK_MS	100	/* detect pin work is run again until cvd/sync is locked, */
+#define T132B_DET_RECHECK_NUM	10	/* at most this many times */
 #endif
+#define T132B_DET_VALID_MS		1000	/* kept result is read from chip again after this */
 
 /**
  * T132B registers definition
@@ -1216,29 +1223,232 @@ struct t132b_init_array init_svga_800x600[]=
 	{0xE3,0x80},
 };
 
+#define T132B_PAGE_NUM		4
+
+/*
+ * Shadow of the page select and of the registers of each page.
+ * page is -1 when current page of chip is unknown.
+ */
+struct t132b_regcache {
+	int			page;
+	u8			val[T132B_PAGE_NUM][256];
+	unsigned long	valid[T132B_PAGE_NUM][BITS_TO_LONGS(256)];
+};
+
+/*
+ * Back and front devices of board may be the same chip(same i2c adapter and address),
+ * each has its own t132b_state, what belongs to the chip is shared by them here.
+ */
+struct t132b_chip {
+	struct list_head	list;
+	struct i2c_adapter	*adapter;
+	unsigned short		addr;
+	int					users;
+	struct mutex		mutex;	/* mutual excl. when accessing chip */
+	struct t132b_state	*owner;	/* state which has programmed chip last */
+	bool				no_burst;	/* burst write wasn't read back, registers are written one by one */
+	struct t132b_regcache	regcache;
+};
+
 struct t132b_state {
 	struct v4l2_subdev	sd;
-	struct mutex		mutex; /* mutual excl. when accessing chip */
+	struct t132b_chip	*chip;
 #if DRIVER_FOR_ROCKCHIP
 	int			cvbs_irq;
 	int         ycrcb_irq;
-	struct work_struct	ycrcb_work;
-	struct work_struct	cvbs_work;
+	struct delayed_work	ycrcb_work;
+	struct delayed_work	cvbs_work;
+	int			cvbs_recheck;	/* recheck times left, set by irq and used by work */
+	int			ycrcb_recheck;
 #endif
+	spinlock_t		det_lock;	/* protects det_xxx */
+	bool			det_seen;	/* det_status/det_std are last result of current input */
+	bool			det_valid;	/* last result was locked, it is used until det_time + T132B_DET_VALID_MS */
+	unsigned long	det_time;
+	u32				det_status;
+	v4l2_std_id		det_std;
 	v4l2_std_id		curr_norm;
 	bool			autodetect;
 	bool			en_output;
 	struct soc_camera_device *icd;
 	unsigned int	input_mode;
 	unsigned int 	output_mode;
+	bool			programmed;	/* chip has been configured as input_mode/output_mode/curr_norm, if it is chip->owner */
 };
 
-static inline void t132b_config_array(struct i2c_client *client, const struct t132b_init_array *tab, size_t cnt)
+static LIST_HEAD(t132b_chips);
+static DEFINE_MUTEX(t132b_chips_lock);
+
+static inline struct t132b_state *to_state(struct v4l2_subdev *sd)
+{
+	return container_of(sd, struct t132b_state, sd);
+}
+
+static inline struct t132b_state *client_to_state(struct i2c_client *client)
+{
+	return to_state(i2c_get_clientdata(client));
+}
+
+static inline bool t132b_input_is_cvbs(unsigned int input)
+{
+	return (input == T132B_INPUT_CVBS_ALL) || (input == T132B_INPUT_CVBS_NTSC)
+		|| (input == T132B_INPUT_CVBS_PAL);
+}
+
+/*
+ * Status and measure registers change by themselves, they are always read from chip.
+ */
+static bool t132b_reg_volatile(int page, u8 reg)
+{
+	if(reg == 0xFF)
+		return true;
+
+	switch(page) {
+	case 0:
+		return (reg == T132B_VS_TIMING_MEAS_REG) || (reg == T132B_VS_PERIOD_LSB_REG)
+			|| (reg == T132B_VS_PERIOD_MSB_REG) || (reg == T132B_CHIPID_REG);
+	case 2:
+		return (reg == T132B_CVD_STATUS_REG) || (reg == T132B_CVD_AUTO_MODE_REG);
+	case 3:
+		return (reg == T132B_INT_STATUS_REG);
+	default:
+		return false;
+	}
+}
+
+/* chip has been reset or cache can't be trusted, forget page and all values */
+static void t132b_regcache_reset(struct t132b_state *state)
+{
+	memset(state->chip->regcache.valid, 0, sizeof(state->chip->regcache.valid));
+	state->chip->regcache.page = -1;
+}
+
+/*
+ * All register accesses go through here. Page select (0xFF) is only sent when
+ * page is changed, registers which aren't volatile are read from cache after first access.
+ */
+static int t132b_write(struct i2c_client *client, u8 reg, u8 val)
 {
-	int i;
+	struct t132b_regcache *cache = &client_to_state(client)->chip->regcache;
+	int page = cache->page;
+	int ret;
+
+	if(reg == 0xFF) {
+		if(page == val)
+			return 0;
+		page = val;
+	}
+
+	ret = i2c_smbus_write_byte_data(client, reg, val);
+	if(ret < 0) {
+		cache->page = -1;
+		return ret;
+	}
 
-	for(i = 0; i < cnt; i++) {
-		i2c_smbus_write_byte_data(client, tab[i].reg, tab[i].val);
+	if(reg == 0xFF) {
+		cache->page = (page < T132B_PAGE_NUM) ? page : -1;
+	} else if(page >= 0) {
+		cache->val[page][reg] = val;
+		__set_bit(reg, cache->valid[page]);
+	}
+	return 0;
+}
+
+static int t132b_read(struct i2c_client *client, u8 reg)
+{
+	struct t132b_regcache *cache = &client_to_state(client)->chip->regcache;
+	int page = cache->page;
+	int ret;
+
+	if((page >= 0) && !t132b_reg_volatile(page, reg)
+		&& test_bit(reg, cache->valid[page]))
+		return cache->val[page][reg];
+
+	ret = i2c_smbus_read_byte_data(client, reg);
+	if((ret >= 0) && (page >= 0) && !t132b_reg_volatile(page, reg)) {
+		cache->val[page][reg] = ret;
+		__set_bit(reg, cache->valid[page]);
+	}
+	return ret;
+}
+
+static int t132b_update_bits(struct i2c_client *client, u8 reg, u8 mask, u8 val)
+{
+	struct t132b_regcache *cache = &client_to_state(client)->chip->regcache;
+	int old;
+
+	/* whole register is written, needn't read it back if it isn't cached */
+	if((mask == 0xFF) && ((cache->page < 0) || t132b_reg_volatile(cache->page, reg)
+		|| !test_bit(reg, cache->valid[cache->page])))
+		return t132b_write(client, reg, val);
+
+	old = t132b_read(client, reg);
+	if(old < 0)
+		return old;
+	if(((old & ~mask) | (val & mask)) == old)
+		return 0;
+	return t132b_write(client, reg, (old & ~mask) | (val & mask));
+}
+
+#define T132B_BURST_MAX		32
+
+/*
+ * A run of consecutive registers is written by one i2c transfer, it expects t132b to increase
+ * register address automatically. The last register of the run is read back from chip to check
+ * that, if it isn't the value written, the run is written one by one and burst isn't used again.
+ * Page select (0xFF) is always written alone.
+ */
+static void t132b_config_array(struct i2c_client *client, const struct t132b_init_array *tab, size_t cnt)
+{
+	struct t132b_state *state = client_to_state(client);
+	struct t132b_regcache *cache = &state->chip->regcache;
+	u8 buf[T132B_BURST_MAX + 1];
+	bool burst = !state->chip->no_burst && i2c_check_functionality(client->adapter, I2C_FUNC_I2C);
+	size_t i, j, n;
+	int last;
+
+	for(i = 0; i < cnt; i += n) {
+		n = 1;
+		/* page must be known for read back */
+		if(burst && (cache->page >= 0) && (tab[i].reg != 0xFF)) {
+			while((i + n < cnt) && (n < T132B_BURST_MAX)
+					&& (tab[i + n].reg == tab[i].reg + n)
+					&& (tab[i + n].reg != 0xFF))
+				n++;
+		}
+
+		if(n == 1) {
+			t132b_write(client, tab[i].reg, tab[i].val);
+			continue;
+		}
+
+		buf[0] = tab[i].reg;
+		for(j = 0; j < n; j++)
+			buf[j + 1] = tab[i + j].val;
+		if(i2c_master_send(client, buf, n + 1) != n + 1) {
+			ERR("burst write 0x%02x-0x%02x failed, write one by one", tab[i].reg, tab[i + n - 1].reg);
+			for(j = 0; j < n; j++)
+				t132b_write(client, tab[i + j].reg, tab[i + j].val);
+			continue;
+		}
+
+		/* read from chip, not cache; volatile register can't be checked */
+		if(!t132b_reg_volatile(cache->page, tab[i + n - 1].reg)) {
+			last = i2c_smbus_read_byte_data(client, tab[i + n - 1].reg);
+			if(last != tab[i + n - 1].val) {
+				ERR("burst write 0x%02x-0x%02x read back 0x%x != 0x%02x, write one by one",
+					tab[i].reg, tab[i + n - 1].reg, last, tab[i + n - 1].val);
+				state->chip->no_burst = true;
+				burst = false;
+				for(j = 0; j < n; j++)
+					t132b_write(client, tab[i + j].reg, tab[i + j].val);
+				continue;
+			}
+		}
+		for(j = 0; j < n; j++) {
+			cache->val[cache->page][tab[i + j].reg] = tab[i + j].val;
+			__set_bit(tab[i + j].reg, cache->valid[cache->page]);
+		}
 	}
 }
 
@@ -1397,10 +1607,10 @@ static int cvd_get_vs_period(struct i2c_client *client)
 	int temp = 0;
 	int i = 0, count = 0;
 
-	i2c_smbus_write_byte_data(client, 0xFF, 0x00);	// select page0
+	t132b_write(client, 0xFF, 0x00);	// select page0
 	for(i = 0; i < 20; i++) {
-		vs_period = i2c_smbus_read_byte_data(client, T132B_VS_PERIOD_LSB_REG);
-		vs_period |= (i2c_smbus_read_byte_data(client, T132B_VS_PERIOD_MSB_REG) << 8);
+		vs_period = t132b_read(client, T132B_VS_PERIOD_LSB_REG);
+		vs_period |= (t132b_read(client, T132B_VS_PERIOD_MSB_REG) << 8);
 		if((temp == (vs_period + 1)) || (temp == (vs_period - 1))
 				|| (temp == vs_period)) {
 			count++;
@@ -1409,7 +1619,7 @@ static int cvd_get_vs_period(struct i2c_client *client)
 		} else {
 			count = 0;
 			temp = vs_period;
-			if(i2c_smbus_read_byte_data(client, T132B_VS_PERIOD_LSB_REG)
+			if(t132b_read(client, T132B_VS_PERIOD_LSB_REG)
 					& T132B_SHORT_VS_FREERUN)
 				break;
 		}
@@ -1425,8 +1635,8 @@ static v4l2_std_id cvbs_get_std(struct i2c_client *client)
 #if 0	/* TODO: support all std. */
 	int color_cubcarrire;
 
-	i2c_smbus_write_byte_data(client, 0xFF, 0x02);	// select page2
-	color_cubcarrire = i2c_smbus_read_byte_data(client, T132B_CVD_AUTO_MODE_REG);
+	t132b_write(client, 0xFF, 0x02);	// select page2
+	color_cubcarrire = t132b_read(client, T132B_CVD_AUTO_MODE_REG);
 	color_cubcarrire |= 0x30;
 	vtotal = cvd_get_vs_period(client);
 	if((vtotal >= 261) && (vtotal <= 264)
@@ -1494,10 +1704,10 @@ static int __t132b_status2(struct i2c_client *client, u32 *status,
 {
 	int status1;
 
-	i2c_smbus_write_byte_data(client, 0xFF, 0x03);	// select page3
-	status1 = i2c_smbus_read_byte_data(client, T132B_INT_STATUS_REG);
-	i2c_smbus_write_byte_data(client, T132B_INT_STATUS_REG, 0x3F);	// w1c
-	i2c_smbus_write_byte_data(client, 0xFF, 0x00);	// select page0
+	t132b_write(client, 0xFF, 0x03);	// select page3
+	status1 = t132b_read(client, T132B_INT_STATUS_REG);
+	t132b_write(client, T132B_INT_STATUS_REG, 0x3F);	// w1c
+	t132b_write(client, 0xFF, 0x00);	// select page0
 
 	/* check signal */
 	if((status1 & (T132B_STA_LOST_HSYNC | T132B_STA_LOST_VSYNC))
@@ -1507,13 +1717,13 @@ static int __t132b_status2(struct i2c_client *client, u32 *status,
 		/* no signal */
 		status1 = V4L2_IN_ST_NO_SIGNAL;
 		/* close panel (enable build-in pattern and freerun) */
-		i2c_smbus_write_byte_data(client, 0x91, 0x87);
-		i2c_smbus_write_byte_data(client, 0xC2, 0x12);
+		t132b_update_bits(client, 0x91, 0xFF, 0x87);
+		t132b_update_bits(client, 0xC2, 0xFF, 0x12);
 	} else {
 		status1 = 0;
 		/* open panel (close build-in pattern and freerun) */
-		i2c_smbus_write_byte_data(client, 0x91, 0x07);
-		i2c_smbus_write_byte_data(client, 0xC2, 0x00);
+		t132b_update_bits(client, 0x91, 0xFF, 0x07);
+		t132b_update_bits(client, 0xC2, 0xFF, 0x00);
 	}
 
 	/* YCbCr 480i/576i */
@@ -1558,9 +1768,8 @@ static int __t132b_status(struct i2c_client *client, u32 *status,
 {
 	int status1;
 
-	i2c_smbus_write_byte_data(client, 0xFF, 0x02);	// select page2
-	status1 = i2c_smbus_read_byte_data(client, T132B_CVD_STATUS_REG);
-	i2c_smbus_write_byte_data(client, 0xFF, 0x00);	// select page0
+	t132b_write(client, 0xFF, 0x02);	// select page2
+	status1 = t132b_read(client, T132B_CVD_STATUS_REG);
 
 	if (status1 < 0)
 		return status1;
@@ -1573,53 +1782,119 @@ static int __t132b_status(struct i2c_client *client, u32 *status,
 	return 0;
 }
 
-static inline struct t132b_state *to_state(struct v4l2_subdev *sd)
+/*
+ * Result of detection is kept in state when detect interrupts are available and it is locked,
+ * it is refreshed by t132b_cvbs_work/t132b_ycrcb_work, read from chip again when it is older
+ * than T132B_DET_VALID_MS and dropped when input is changed.
+ */
+static bool t132b_det_get(struct t132b_state *state, u32 *status, v4l2_std_id *std)
 {
-	return container_of(sd, struct t132b_state, sd);
+	bool valid;
+
+	spin_lock(&state->det_lock);
+	valid = state->autodetect && state->det_valid
+		&& time_before(jiffies, state->det_time + msecs_to_jiffies(T132B_DET_VALID_MS));
+	if (valid) {
+		if (status)
+			*status = state->det_status;
+		if (std)
+			*std = state->det_std;
+	}
+	spin_unlock(&state->det_lock);
+
+	return valid;
 }
 
+static void t132b_det_invalidate(struct t132b_state *state)
+{
+	spin_lock(&state->det_lock);
+	state->det_seen = false;
+	state->det_valid = false;
+	spin_unlock(&state->det_lock);
+}
+
+/* cvd is locked to a std for CVBS, or sync is found for the others */
+static inline bool t132b_det_locked(unsigned int input, u32 status, v4l2_std_id std)
+{
+	if (status)
+		return false;
+	return !t132b_input_is_cvbs(input) || (std != V4L2_STD_UNKNOWN);
+}
+
+/* read status and std of current input from chip, called with chip->mutex held */
+static int t132b_detect(struct t132b_state *state, u32 *status, v4l2_std_id *std)
+{
+	struct i2c_client *client = v4l2_get_subdevdata(&state->sd);
+	u32 det_status;
+	v4l2_std_id det_std;
+	int ret;
+
+	if (!state->autodetect) {
+		if (t132b_input_is_cvbs(state->input_mode))
+			return __t132b_status(client, status, std);
+		else
+			return __t132b_status2(client, status, std, state->input_mode);
+	}
+
+	if (t132b_input_is_cvbs(state->input_mode))
+		ret = __t132b_status(client, &det_status, &det_std);
+	else
+		ret = __t132b_status2(client, &det_status, &det_std, state->input_mode);
+	if (ret)
+		return ret;
+
+	spin_lock(&state->det_lock);
+	state->det_status = det_status;
+	state->det_std = det_std;
+	state->det_seen = true;
+	state->det_valid = t132b_det_locked(state->input_mode, det_status, det_std);
+	state->det_time = jiffies;
+	spin_unlock(&state->det_lock);
+
+	DBG("%s input 0x%x status 0x%x std 0x%llx", __FUNCTION__, state->input_mode,
+		det_status, (unsigned long long)det_std);
+	if (status)
+		*status = det_status;
+	if (std)
+		*std = det_std;
+	return 0;
+}
+
+/* called with chip->mutex held */
 static void t132b_out_ctl(struct v4l2_subdev *sd, bool onoff)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	struct t132b_state *state = to_state(sd);
-	int val = 0;
 
 	DBG("%s onoff %d", __FUNCTION__, onoff);
 
 	if(onoff == 0) {
 		// disable output
-		i2c_smbus_write_byte_data(client, 0xFF, 0x03);	// select page3
-		val = i2c_smbus_read_byte_data(client, 0x1A);
-		i2c_smbus_write_byte_data(client, 0x1A, val & 0xFE);	// disable CCIR656 output
-		val = i2c_smbus_read_byte_data(client, 0x1B);
-		i2c_smbus_write_byte_data(client, 0x1B, val & 0xFE);	// disable CCIR601 output
-		i2c_smbus_write_byte_data(client, 0xFF, 0x00);	// select page0
+		t132b_write(client, 0xFF, 0x03);	// select page3
+		t132b_update_bits(client, 0x1A, 0x01, 0x00);	// disable CCIR656 output
+		t132b_update_bits(client, 0x1B, 0x01, 0x00);	// disable CCIR601 output
 		state->en_output = 0;
 	} else {
 		if(state->input_mode == T132B_INPUT_CVBS_ALL
 			|| state->input_mode == T132B_INPUT_CVBS_NTSC
 			|| state->input_mode == T132B_INPUT_CVBS_PAL) {
-			i2c_smbus_write_byte_data(client, 0xFF, 0x00);	// select page0
+			t132b_write(client, 0xFF, 0x00);	// select page0
 			/* open panel (close build-in pattern and freerun) */
-			i2c_smbus_write_byte_data(client, 0x91, 0x07);
-			i2c_smbus_write_byte_data(client, 0xC2, 0x00);
+			t132b_update_bits(client, 0x91, 0xFF, 0x07);
+			t132b_update_bits(client, 0xC2, 0xFF, 0x00);
 		} else {
-			i2c_smbus_write_byte_data(client, 0xFF, 0x03);	// select page3
-			i2c_smbus_write_byte_data(client, T132B_INT_STATUS_REG, 0x3F);	// w1c
+			t132b_write(client, 0xFF, 0x03);	// select page3
+			t132b_write(client, T132B_INT_STATUS_REG, 0x3F);	// w1c
 			/* check signal and if no signal enable build-in pattern */
 			__t132b_status2(client, NULL, NULL, state->input_mode);
 		}
 		// enable output
 		if(state->output_mode == T132B_OUTPUT_CCIR601) {
-			i2c_smbus_write_byte_data(client, 0xFF, 0x03);	// select page3
-			val = i2c_smbus_read_byte_data(client, 0x1B);
-			i2c_smbus_write_byte_data(client, 0x1B, val | 0x01); // enable CCIR601 output
-			i2c_smbus_write_byte_data(client, 0xFF, 0x00);	// select page0
+			t132b_write(client, 0xFF, 0x03);	// select page3
+			t132b_update_bits(client, 0x1B, 0x01, 0x01); // enable CCIR601 output
 		} else {
-			i2c_smbus_write_byte_data(client, 0xFF, 0x03);	// select page3
-			val = i2c_smbus_read_byte_data(client, 0x1A);
-			i2c_smbus_write_byte_data(client, 0x1A, val | 0x01); // enable CCIR656 output
-			i2c_smbus_write_byte_data(client, 0xFF, 0x00);	// select page0
+			t132b_write(client, 0xFF, 0x03);	// select page3
+			t132b_update_bits(client, 0x1A, 0x01, 0x01); // enable CCIR656 output
 		}
 		state->en_output = 1;
 	}
@@ -1647,56 +1922,122 @@ static void t132b_pwr_ctl(struct soc_camera_device *icd, bool onoff)
 static int t132b_querystd(struct v4l2_subdev *sd, v4l2_std_id *std)
 {
 	struct t132b_state *state = to_state(sd);
-	int err = mutex_lock_interruptible(&state->mutex);
-	if (err)
-		return err;
+	int err;
+
 	if(state->output_mode == T132B_OUTPUT_CCIR601
 		/* state->input_mode != T132B_INPUT_CVBS_ALL
 			&& state->input_mode != T132B_INPUT_CVBS_NTSC
 			&& state->input_mode != T132B_INPUT_CVBS_PAL */) {
-		err = -1;	/* CCIR656 configure for rockchip  */
-	} else {
-		if(state->input_mode == T132B_INPUT_CVBS_ALL
-				|| state->input_mode == T132B_INPUT_CVBS_NTSC
-				|| state->input_mode == T132B_INPUT_CVBS_PAL) {
-			err = __t132b_status(v4l2_get_subdevdata(sd), NULL, std);
-		} else {
-			err = __t132b_status2(v4l2_get_subdevdata(sd), NULL, std, state->input_mode);
-		}
+		return -1;	/* CCIR656 configure for rockchip  */
 	}
-	mutex_unlock(&state->mutex);
+
+	/* detected by interrupt, chip needn't be polled */
+	if (t132b_det_get(state, NULL, std))
+		return 0;
+
+	err = mutex_lock_interruptible(&state->chip->mutex);
+	if (err)
+		return err;
+	err = t132b_detect(state, NULL, std);
+	mutex_unlock(&state->chip->mutex);
 	return err;
 }
 
 static int t132b_g_input_status(struct v4l2_subdev *sd, u32 *status)
 {
 	struct t132b_state *state = to_state(sd);
-	int ret = mutex_lock_interruptible(&state->mutex);
+	int ret;
+
+	if (t132b_det_get(state, status, NULL))
+		return 0;
+
+	ret = mutex_lock_interruptible(&state->chip->mutex);
 	if (ret)
 		return ret;
+	ret = t132b_detect(state, status, NULL);
+	mutex_unlock(&state->chip->mutex);
+	return ret;
+}
 
-	if(state->input_mode == T132B_INPUT_CVBS_ALL
-			|| state->input_mode == T132B_INPUT_CVBS_NTSC
-			|| state->input_mode == T132B_INPUT_CVBS_PAL) {
-		ret = __t132b_status(v4l2_get_subdevdata(sd), status, NULL);
-	} else {
-		ret = __t132b_status2(v4l2_get_subdevdata(sd), status, NULL, state->input_mode);
+/*
+ * The build-in pattern color is set by t132b_v4l2_init and isn't in any table,
+ * it is lost when t132b is reset or powered off. Chip is read directly here,
+ * register cache is dropped too if chip has lost its configuration.
+ * Pattern color is the same for all modes, so chip must also be programmed by this state
+ * last, not by the other device of the same chip.
+ */
+static bool t132b_is_programmed(struct i2c_client *client, struct t132b_state *state)
+{
+	if (!state->programmed || (state->chip->owner != state)) {
+		state->programmed = false;
+		t132b_regcache_reset(state);
+		return false;
 	}
 
-	mutex_unlock(&state->mutex);
-	return ret;
+	/* page and pattern color are read from chip, not cache */
+	state->chip->regcache.page = -1;
+	t132b_write(client, 0xFF, 0x00);	// select page0
+	__clear_bit(0x9D, state->chip->regcache.valid[0]);
+	__clear_bit(0x9E, state->chip->regcache.valid[0]);
+	__clear_bit(0x9F, state->chip->regcache.valid[0]);
+	if ((t132b_read(client, 0x9D) != 0x1D)
+		|| (t132b_read(client, 0x9E) != 0xF0)
+		|| (t132b_read(client, 0x9F) != 0x6C)) {
+		state->programmed = false;
+		t132b_regcache_reset(state);
+	}
+
+	return state->programmed;
 }
 
-static int t132b_v4l2_init(struct v4l2_subdev *sd, u32 val)
+/*
+ * Chip, register cache and input/output state are changed with chip->mutex held,
+ * detect works reconfigure the chip under it too.
+ */
+static int __t132b_v4l2_init(struct v4l2_subdev *sd, u32 val)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
     struct soc_camera_device *icd = client->dev.platform_data;
 	struct t132b_state *state = to_state(sd);
+	unsigned int input_mode, output_mode;
 
 	DBG("%s val %d", __FUNCTION__, val);
 	t132b_pwr_ctl(icd, 1);
 
+	// select input & output mode
+	DBG("%s devnum %d init", __FUNCTION__, icd->devnum);
+	switch(icd->devnum) {
+	case 2:
+		printk("input CVBS NTSC mode and 656 output mode\n");
+		input_mode = T132B_INPUT_CVBS_NTSC;
+		output_mode = T132B_OUTPUT_CCIR656;
+		break;
+	case 1:
+		printk("input YUV 480P mode and 601 output mode\n");
+		input_mode = T132B_INPUT_YUV_480P;
+		output_mode = T132B_OUTPUT_CCIR601;
+		break;
+	case 0:
+	default:
+		printk("t132b default init, input cvbs mode and 656 output mode\n");
+		input_mode = T132B_INPUT_CVBS_ALL;
+		output_mode = T132B_OUTPUT_CCIR656;
+		break;
+	}
+
+	/* chip keeps the configuration since last init, tables and detection delay needn't again */
+	if ((state->input_mode == input_mode) && (state->output_mode == output_mode)
+		&& t132b_is_programmed(client, state)) {
+		DBG("%s devnum %d has been initialized", __FUNCTION__, icd->devnum);
+		if (!state->en_output)
+			t132b_out_ctl(sd, 1);
+		return 0;
+	}
+
 	/* clear state */
+	t132b_regcache_reset(state);
+	t132b_det_invalidate(state);
+	state->programmed = false;
 	state->input_mode = 0;
 	state->output_mode = 0;
 	state->curr_norm = 0;
@@ -1707,47 +2048,38 @@ static int t132b_v4l2_init(struct v4l2_subdev *sd, u32 val)
 
 	/* Initialize t132b */
 	// disable power saving
-	i2c_smbus_write_byte_data(client, 0xFF, 0x00);	// select page0
-	i2c_smbus_write_byte_data(client, 0xFC, 0x0F);
-	i2c_smbus_write_byte_data(client, 0xFD, 0x07);
+	t132b_write(client, 0xFF, 0x00);	// select page0
+	t132b_write(client, 0xFC, 0x0F);
+	t132b_write(client, 0xFD, 0x07);
 
 	// pad init
-	i2c_smbus_write_byte_data(client, 0xFF, 0x01);	// select page1
-	i2c_smbus_write_byte_data(client, 0xE5, 0x10);
-	i2c_smbus_write_byte_data(client, 0xFF, 0x00);	// select page0
+	t132b_write(client, 0xFF, 0x01);	// select page1
+	t132b_write(client, 0xE5, 0x10);
+	t132b_write(client, 0xFF, 0x00);	// select page0
 
 	// set blue color for build-in pattern
-	i2c_smbus_write_byte_data(client, 0x9D, 0x1D);	// Y
-	i2c_smbus_write_byte_data(client, 0x9E, 0xF0);	// U
-	i2c_smbus_write_byte_data(client, 0x9F, 0x6C);	// V
+	t132b_write(client, 0x9D, 0x1D);	// Y
+	t132b_write(client, 0x9E, 0xF0);	// U
+	t132b_write(client, 0x9F, 0x6C);	// V
 
 	// set input & output mode
-	DBG("%s devnum %d init", __FUNCTION__, icd->devnum);
-	switch(icd->devnum) {
-	case 2:
-		printk("input CVBS NTSC mode and 656 output mode\n");
-		state->input_mode = T132B_INPUT_CVBS_NTSC;
-		state->output_mode = T132B_OUTPUT_CCIR656;
+	state->input_mode = input_mode;
+	state->output_mode = output_mode;
+	switch(state->input_mode) {
+	case T132B_INPUT_CVBS_NTSC:
 		change_output_config(client, state->input_mode, state->output_mode, 0);
 		change_input_config(client, state->input_mode, state->output_mode, T132B_INPUT_CVBS_NTSC);
 		break;
-	case 1:
-		printk("input YUV 480P mode and 601 output mode\n");
-		state->input_mode = T132B_INPUT_YUV_480P;
-		state->output_mode = T132B_OUTPUT_CCIR601;
+	case T132B_INPUT_YUV_480P:
 		change_output_config(client, state->input_mode, state->output_mode, 0);
 		change_input_config(client, state->input_mode, state->output_mode, 0);
 		break;
-	case 0:
 	default:
-		printk("t132b default init, input cvbs mode and 656 output mode\n");
-		state->input_mode = T132B_INPUT_CVBS_ALL;
-		state->output_mode = T132B_OUTPUT_CCIR656;
 		change_output_config(client, state->input_mode, state->output_mode, 0);
 		change_input_config(client, state->input_mode, state->output_mode, V4L2_STD_NTSC);
 		msleep(100);
 		/* check current std. */
-		__t132b_status(client, NULL, &state->curr_norm);
+		t132b_detect(state, NULL, &state->curr_norm);
 		if(state->curr_norm == V4L2_STD_PAL) {
 			change_input_config(client, state->input_mode, state->output_mode, state->curr_norm);
 		}
@@ -1756,6 +2088,8 @@ static int t132b_v4l2_init(struct v4l2_subdev *sd, u32 val)
 
 	/* enable output */
 	t132b_out_ctl(sd, 1);
+	state->programmed = true;
+	state->chip->owner = state;
 
 	return 0;
 
@@ -1765,7 +2099,18 @@ err_unreg_subdev:
 #endif
 }
 
-static long t132b_ioctl(struct v4l2_subdev *sd, unsigned int cmd, void *arg)
+static int t132b_v4l2_init(struct v4l2_subdev *sd, u32 val)
+{
+	struct t132b_state *state = to_state(sd);
+	int ret;
+
+	mutex_lock(&state->chip->mutex);
+	ret = __t132b_v4l2_init(sd, val);
+	mutex_unlock(&state->chip->mutex);
+	return ret;
+}
+
+static long __t132b_ioctl(struct v4l2_subdev *sd, unsigned int cmd, void *arg)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
     struct soc_camera_device *icd = client->dev.platform_data;
@@ -1813,10 +2158,22 @@ static long t132b_ioctl(struct v4l2_subdev *sd, unsigned int cmd, void *arg)
 	}
 	state->input_mode = cmd;
 	change_input_config(client, state->input_mode, state->output_mode, state->curr_norm);
+	t132b_det_invalidate(state);
 
 	return 0;
 }
 
+static long t132b_ioctl(struct v4l2_subdev *sd, unsigned int cmd, void *arg)
+{
+	struct t132b_state *state = to_state(sd);
+	long ret;
+
+	mutex_lock(&state->chip->mutex);
+	ret = __t132b_ioctl(sd, cmd, arg);
+	mutex_unlock(&state->chip->mutex);
+	return ret;
+}
+
 static int t132b_g_chip_ident(struct v4l2_subdev *sd,
 	struct v4l2_dbg_chip_ident *chip)
 {
@@ -1829,10 +2186,11 @@ static int t132b_s_std(struct v4l2_subdev *sd, v4l2_std_id std)
 {
 	struct t132b_state *state = to_state(sd);
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
-	int ret = mutex_lock_interruptible(&state->mutex);
+	int ret = mutex_lock_interruptible(&state->chip->mutex);
 	if (ret)
 		return ret;
 
+	t132b_det_invalidate(state);
 	/* all standards -> autodetect */
 	if (std == V4L2_STD_ALL) {
 		state->input_mode = T132B_INPUT_CVBS_ALL;
@@ -1856,7 +2214,7 @@ static int t132b_s_std(struct v4l2_subdev *sd, v4l2_std_id std)
 	}
 	ret = 0;
 out:
-	mutex_unlock(&state->mutex);
+	mutex_unlock(&state->chip->mutex);
 	return ret;
 }
 
@@ -1897,6 +2255,7 @@ static int t132b_set_mbus_fmt(struct v4l2_subdev *sd, struct v4l2_mbus_framefmt
 	DBG("%s width %d height %d code 0x%x colorspace 0x%x",
 		__FUNCTION__, mf->width, mf->height, mf->code, mf->colorspace);
 
+	mutex_lock(&state->chip->mutex);
 	switch(state->input_mode) {
 	case T132B_INPUT_CVBS_ALL:
 //		__t132b_status(client, NULL, &state->curr_norm);
@@ -1927,6 +2286,7 @@ static int t132b_set_mbus_fmt(struct v4l2_subdev *sd, struct v4l2_mbus_framefmt
 		index = 0;
 		break;
 	}
+	mutex_unlock(&state->chip->mutex);
 	mf->width	= t132b_pic_sizes[index].width;
 	mf->height	= t132b_pic_sizes[index].height;
 
@@ -2057,8 +2417,14 @@ static int t132b_suspend(struct soc_camera_device *icd, pm_message_t pm_msg)
 
 static int t132b_resume(struct soc_camera_device *icd)
 {
+	struct v4l2_subdev *sd = soc_camera_to_subdev(icd);
+
 	DBG("%s", __FUNCTION__);
 	t132b_pwr_ctl(icd, 1);
+	/* chip may have been powered off */
+	mutex_lock(&to_state(sd)->chip->mutex);
+	t132b_regcache_reset(to_state(sd));
+	mutex_unlock(&to_state(sd)->chip->mutex);
 	return 0;
 }
 
@@ -2093,33 +2459,88 @@ static const struct v4l2_subdev_ops t132b_ops = {
 };
 
 #if DRIVER_FOR_ROCKCHIP
+/*
+ * Called with chip->mutex held when detect pin is changed. CVBS auto input is configured
+ * again if std is changed, and host is notified if std or signal is changed, so app can
+ * set format again without reopen. Returns true if the result is locked.
+ */
+static bool t132b_source_update(struct t132b_state *state)
+{
+	struct i2c_client *client = v4l2_get_subdevdata(&state->sd);
+	u32 old_status, status;
+	v4l2_std_id old_std, std;
+	bool old_seen;
+	u32 changes = 0;
+
+	spin_lock(&state->det_lock);
+	old_seen = state->det_seen;
+	old_status = state->det_status;
+	old_std = state->det_std;
+	spin_unlock(&state->det_lock);
+	if (t132b_detect(state, &status, &std))
+		return false;
+
+	if ((state->input_mode == T132B_INPUT_CVBS_ALL)
+		&& ((std == V4L2_STD_NTSC) || (std == V4L2_STD_PAL))
+		&& (std != state->curr_norm)) {
+		DBG("%s std 0x%llx -> 0x%llx", __FUNCTION__,
+			(unsigned long long)state->curr_norm, (unsigned long long)std);
+		state->curr_norm = std;
+		change_input_config(client, state->input_mode, state->output_mode, std);
+		changes |= RK_CAM_SRC_CH_RESOLUTION;
+	}
+	if (old_seen && ((status != old_status) || (std != old_std)))
+		changes |= RK_CAM_SRC_CH_RESOLUTION;
+
+	if (changes)
+		v4l2_subdev_notify(&state->sd, RK_CAM_NOTIFY_SOURCE_CHANGE, &changes);
+
+	return t132b_det_locked(state->input_mode, status, std);
+}
+
+/* rk30 gpio can't trigger on both edges, so wait for the edge opposite to current level */
+static unsigned long t132b_det_trigger(unsigned gpio)
+{
+	return gpio_get_value(gpio) ? IRQF_TRIGGER_FALLING : IRQF_TRIGGER_RISING;
+}
+
 static void t132b_cvbs_work(struct work_struct *cvbs_work)
 {
-	struct t132b_state *state = container_of(cvbs_work, struct t132b_state,
+	struct t132b_state *state = container_of(to_delayed_work(cvbs_work), struct t132b_state,
 		cvbs_work);
-//	struct i2c_client *client = v4l2_get_subdevdata(&state->sd);
-
-	mutex_lock(&state->mutex);
-#if 0	// TODO: auto detection input mode
+	bool locked = true;
 
-#endif
-	mutex_unlock(&state->mutex);
+	mutex_lock(&state->chip->mutex);
+	if (state->programmed && (state->chip->owner == state) && t132b_input_is_cvbs(state->input_mode))
+		locked = t132b_source_update(state);
+	mutex_unlock(&state->chip->mutex);
 
+	/* cvd isn't locked yet after the edge, irq is kept disabled until recheck is done */
+	if (!locked && (state->cvbs_recheck-- > 0)) {
+		schedule_delayed_work(&state->cvbs_work, msecs_to_jiffies(T132B_DET_RECHECK_MS));
+		return;
+	}
+	irq_set_irq_type(state->cvbs_irq, t132b_det_trigger(T132B_CVBS_IN_DET));
 	enable_irq(state->cvbs_irq);
 }
 
 static void t132b_ycrcb_work(struct work_struct *ycrcb_work)
 {
-	struct t132b_state *state = container_of(ycrcb_work, struct t132b_state,
+	struct t132b_state *state = container_of(to_delayed_work(ycrcb_work), struct t132b_state,
 		ycrcb_work);
-//	struct i2c_client *client = v4l2_get_subdevdata(&state->sd);
+	bool locked = true;
 
-	mutex_lock(&state->mutex);
-#if 0	// TODO: auto detection input mode
-
-#endif
-	mutex_unlock(&state->mutex);
+	mutex_lock(&state->chip->mutex);
+	if (state->programmed && (state->chip->owner == state)
+		&& state->input_mode && !t132b_input_is_cvbs(state->input_mode))
+		locked = t132b_source_update(state);
+	mutex_unlock(&state->chip->mutex);
 
+	if (!locked && (state->ycrcb_recheck-- > 0)) {
+		schedule_delayed_work(&state->ycrcb_work, msecs_to_jiffies(T132B_DET_RECHECK_MS));
+		return;
+	}
+	irq_set_irq_type(state->ycrcb_irq, t132b_det_trigger(T132B_YCRCB_IN_DET));
 	enable_irq(state->ycrcb_irq);
 }
 
@@ -2127,7 +2548,8 @@ static irqreturn_t t132b_cvbs_irq(int irq, void *devid)
 {
 	struct t132b_state *state = devid;
 
-	schedule_work(&state->cvbs_work);
+	state->cvbs_recheck = T132B_DET_RECHECK_NUM;
+	schedule_delayed_work(&state->cvbs_work, msecs_to_jiffies(T132B_DET_DEBOUNCE_MS));
 
 	disable_irq_nosync(state->cvbs_irq);
 
@@ -2139,22 +2561,78 @@ static irqreturn_t t132b_ycrcb_irq(int irq, void *devid)
 {
 	struct t132b_state *state = devid;
 
-	schedule_work(&state->ycrcb_work);
+	state->ycrcb_recheck = T132B_DET_RECHECK_NUM;
+	schedule_delayed_work(&state->ycrcb_work, msecs_to_jiffies(T132B_DET_DEBOUNCE_MS));
 
 	disable_irq_nosync(state->ycrcb_irq);
 
 	return IRQ_HANDLED;
 }
+
+static int t132b_det_irq_init(struct t132b_state *state)
+{
+	int ret;
+
+	rk30_mux_api_set(GPIO0B7_I2S8CHSDO3_NAME, GPIO0B_GPIO0B7);
+	ret = gpio_request(T132B_CVBS_IN_DET, "TW_CVBS_INT");
+	if (ret != 0) {
+		printk(KERN_ERR "request T132B_CVBS_IN_DET pin fail!\n");
+		return ret;
+	}
+	gpio_direction_input(T132B_CVBS_IN_DET);
+
+	ret = gpio_request(T132B_YCRCB_IN_DET, "TW_YCRCB_INT");
+	if (ret != 0) {
+		printk(KERN_ERR "request T132B_YCRCB_IN_DET  pin fail!\n");
+		goto err_ycrcb_gpio;
+	}
+	gpio_direction_input(T132B_YCRCB_IN_DET);
+
+	state->cvbs_irq = gpio_to_irq(T132B_CVBS_IN_DET);
+	ret = request_irq(state->cvbs_irq, t132b_cvbs_irq, t132b_det_trigger(T132B_CVBS_IN_DET),
+		"t132b_cvbs", state);
+	if (ret != 0) {
+		printk(KERN_ERR "request T132B cvbs irq %d fail!\n", state->cvbs_irq);
+		goto err_cvbs_irq;
+	}
+
+	state->ycrcb_irq = gpio_to_irq(T132B_YCRCB_IN_DET);
+	ret = request_irq(state->ycrcb_irq, t132b_ycrcb_irq, t132b_det_trigger(T132B_YCRCB_IN_DET),
+		"t132b_ycrcb", state);
+	if (ret != 0) {
+		printk(KERN_ERR "request T132B ycrcb irq %d fail!\n", state->ycrcb_irq);
+		goto err_ycrcb_irq;
+	}
+
+	return 0;
+
+err_ycrcb_irq:
+	free_irq(state->cvbs_irq, state);
+err_cvbs_irq:
+	state->cvbs_irq = 0;
+	state->ycrcb_irq = 0;
+	gpio_free(T132B_YCRCB_IN_DET);
+err_ycrcb_gpio:
+	gpio_free(T132B_CVBS_IN_DET);
+	return ret;
+}
 #endif
 
 static ssize_t store_dbg(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
-    int reg, val;
+    int reg, val, ret;
     struct i2c_client *client = to_i2c_client(dev);
+    struct t132b_state *state = client_to_state(client);
 
     sscanf(buf, "%x %x", &reg, &val);
-    i2c_smbus_write_byte_data(client, reg, val);
-    printk("write 0x%02x = 0x%02x, ret = 0x%02x\n", reg, val, i2c_smbus_read_byte_data(client, reg));
+    mutex_lock(&state->chip->mutex);
+    t132b_write(client, reg, val);
+    /* read back from chip, and cache is synced to it */
+    if (state->chip->regcache.page >= 0)
+        __clear_bit(reg & 0xFF, state->chip->regcache.valid[state->chip->regcache.page]);
+    ret = t132b_read(client, reg);
+    mutex_unlock(&state->chip->mutex);
+    printk("write 0x%02x = 0x%02x, ret = 0x%02x\n", reg, val, ret);
 
     return count;
 }
@@ -2172,6 +2650,46 @@ static struct device_attribute t132b_dev_attr = {
  * concerning the addresses: i2c wants 7 bit (without the r/w bit), so '>>1'
  */
 
+/* find the chip of client, or create it if client is its first device */
+static struct t132b_chip *t132b_chip_get(struct i2c_client *client)
+{
+	struct t132b_chip *chip;
+
+	mutex_lock(&t132b_chips_lock);
+	list_for_each_entry(chip, &t132b_chips, list) {
+		if ((chip->adapter == client->adapter) && (chip->addr == client->addr))
+			goto found;
+	}
+	chip = kzalloc(sizeof(struct t132b_chip), GFP_KERNEL);
+	if (chip == NULL)
+		goto out;
+	chip->adapter = client->adapter;
+	chip->addr = client->addr;
+	mutex_init(&chip->mutex);
+	chip->regcache.page = -1;
+	list_add(&chip->list, &t132b_chips);
+found:
+	chip->users++;
+out:
+	mutex_unlock(&t132b_chips_lock);
+	return chip;
+}
+
+static void t132b_chip_put(struct t132b_state *state)
+{
+	struct t132b_chip *chip = state->chip;
+
+	mutex_lock(&t132b_chips_lock);
+	if (chip->owner == state)
+		chip->owner = NULL;
+	if (--chip->users == 0) {
+		list_del(&chip->list);
+		mutex_destroy(&chip->mutex);
+		kfree(chip);
+	}
+	mutex_unlock(&t132b_chips_lock);
+}
+
 static int t132b_probe(struct i2c_client *client,
 			const struct i2c_device_id *id)
 {
@@ -2194,36 +2712,15 @@ static int t132b_probe(struct i2c_client *client,
 		goto err;
 	}
 
-#if 0 /* TODO: add auto detected from interrupt with GPIO pins */
-	rk30_mux_api_set(GPIO0B7_I2S8CHSDO3_NAME, GPIO0B_GPIO0B7);
-	ret = gpio_request(T132B_CVBS_IN_DET, "TW_CVBS_INT");
-	if (ret != 0)
-	{
-		gpio_free(T132B_CVBS_IN_DET);
-		printk(KERN_ERR "request T132B_CVBS_IN_DET pin fail!\n");
-		return -1;
-	}
-	gpio_direction_input(T132B_CVBS_IN_DET);
 
-	ret = gpio_request(T132B_YCRCB_IN_DET, "TW_YCRCB_INT");
-	if (ret != 0)
-	{
-		gpio_free(T132B_YCRCB_IN_DET);
-		printk(KERN_ERR "request T132B_YCRCB_IN_DET  pin fail!\n");
-		return -1;
+	state->chip = t132b_chip_get(client);
+	if (state->chip == NULL) {
+		kfree(state);
+		ret = -ENOMEM;
+		goto err;
 	}
-	gpio_direction_input(T132B_YCRCB_IN_DET);
-
-	state->cvbs_irq = gpio_to_irq(T132B_CVBS_IN_DET);
-	state->ycrcb_irq = gpio_to_irq(T132B_YCRCB_IN_DET);
-
-	INIT_WORK(&state->cvbs_work, t132b_cvbs_work);
-	INIT_WORK(&state->ycrcb_work, t132b_ycrcb_work);
-#endif
-
-	mutex_init(&state->mutex);
-	/* TODO: add auto detected from interrupt with GPIO pins */
-	state->autodetect = false;	// true;
+	spin_lock_init(&state->det_lock);
+	state->autodetect = false;
 	sd = &state->sd;
 	v4l2_i2c_subdev_init(sd, client, &t132b_ops);
 
@@ -2236,8 +2733,10 @@ static int t132b_probe(struct i2c_client *client,
 	t132b_pwr_ctl(icd, 1);
 	ret = 0;
 
-	i2c_smbus_write_byte_data(client, 0xFF, 0x00);	// select page0
-	ret = i2c_smbus_read_byte_data(client, T132B_CHIPID_REG);
+	mutex_lock(&state->chip->mutex);
+	t132b_write(client, 0xFF, 0x00);	// select page0
+	ret = t132b_read(client, T132B_CHIPID_REG);
+	mutex_unlock(&state->chip->mutex);
 	if (ret != T132B_CHIPID_T132) {
 		printk("ID: 0x%02X not is T132B\n", ret);
 		goto err_unreg_subdev;
@@ -2245,6 +2744,13 @@ static int t132b_probe(struct i2c_client *client,
 
 	t132b_pwr_ctl(icd, 0);
 
+#if DRIVER_FOR_ROCKCHIP
+	/* signal and std are detected by interrupt with GPIO pins, polled if pins aren't available */
+	INIT_DELAYED_WORK(&state->cvbs_work, t132b_cvbs_work);
+	INIT_DELAYED_WORK(&state->ycrcb_work, t132b_ycrcb_work);
+	state->autodetect = (t132b_det_irq_init(state) == 0);
+#endif
+
     ret = device_create_file(&client->dev, &t132b_dev_attr);
     if (ret) {
         printk("create device file failed!\n");
@@ -2257,7 +2763,7 @@ static int t132b_probe(struct i2c_client *client,
 
 err_unreg_subdev:
 	t132b_pwr_ctl(icd, 0);
-	mutex_destroy(&state->mutex);
+	t132b_chip_put(state);
 	v4l2_device_unregister_subdev(sd);
 	kfree(state);
 err:
@@ -2271,32 +2777,26 @@ static int t132b_remove(struct i2c_client *client)
 	struct t132b_state *state = to_state(sd);
 
 #if DRIVER_FOR_ROCKCHIP
+	/* irq can't schedule work again once it is disabled, then work is done before irq is freed */
 	if (state->cvbs_irq > 0) {
+		disable_irq(state->cvbs_irq);
+		cancel_delayed_work_sync(&state->cvbs_work);
 		free_irq(state->cvbs_irq,state);
-		if (cancel_work_sync(&state->cvbs_work)) {
-			/*
-			 * Work was pending, therefore we need to enable
-			 * IRQ here to balance the disable_irq() done in the
-			 * interrupt handler.
-			 */
-			enable_irq(state->cvbs_irq);
-		}
 	}
 
 	if (state->ycrcb_irq > 0) {
+		disable_irq(state->ycrcb_irq);
+		cancel_delayed_work_sync(&state->ycrcb_work);
 		free_irq(state->ycrcb_irq,state);
-		if (cancel_work_sync(&state->ycrcb_work)) {
-			/*
-			 * Work was pending, therefore we need to enable
-			 * IRQ here to balance the disable_irq() done in the
-			 * interrupt handler.
-			 */
-			enable_irq(state->ycrcb_irq);
-		}
+	}
+
+	if (state->autodetect) {
+		gpio_free(T132B_YCRCB_IN_DET);
+		gpio_free(T132B_CVBS_IN_DET);
 	}
 #endif
 
-	mutex_destroy(&state->mutex);
+	t132b_chip_put(state);
 	v4l2_device_unregister_subdev(sd);
 	kfree(to_state(sd));
 	return 0;
@@ -0,0 +1,28 @@
+/*
+ * Notifications from rockchip camera sensors/decoders to the rk cif host
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __RK_CAMERA_NOTIFY_H__
+#define __RK_CAMERA_NOTIFY_H__
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+/* v4l2_subdev_notify() notification, arg is u32 * of RK_CAM_SRC_CH_XXX */
+#define RK_CAM_NOTIFY_SOURCE_CHANGE	_IOW('r', 1, u32)
+
+#define RK_CAM_SRC_CH_RESOLUTION	(1 << 0)
+
+/*
+ * Read only host control, VIDIOC_G_CTRL returns RK_CAM_SRC_CH_XXX notified since
+ * the last read or VIDIOC_S_FMT, and clears them.
+ */
+#define V4L2_CID_RK_CAM_SOURCE_CHANGE	(V4L2_CID_PRIVATE_BASE + 0x100)
+
+#endif /* __RK_CAMERA_NOTIFY_H__ */
@@ -0,0 +1,184 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rk_camera
+
+#if !defined(_TRACE_RK_CAMERA_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_RK_CAMERA_H
+
+#include <linux/ktime.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(rk_camera_irq,
+
+	TP_PROTO(int host, unsigned int intstat, unsigned long cifirq_idx,
+		 unsigned long dmairq_idx),
+
+	TP_ARGS(host, intstat, cifirq_idx, dmairq_idx),
+
+	TP_STRUCT__entry(
+		__field(	int,		host		)
+		__field(	unsigned int,	intstat		)
+		__field(	unsigned long,	cifirq_idx	)
+		__field(	unsigned long,	dmairq_idx	)
+	),
+
+	TP_fast_assign(
+		__entry->host		= host;
+		__entry->intstat	= intstat;
+		__entry->cifirq_idx	= cifirq_idx;
+		__entry->dmairq_idx	= dmairq_idx;
+	),
+
+	TP_printk("cif%d intstat=0x%x cifirq=%lu dmairq=%lu",
+		  __entry->host, __entry->intstat,
+		  __entry->cifirq_idx, __entry->dmairq_idx)
+);
+
+DECLARE_EVENT_CLASS(rk_camera_buf,
+
+	TP_PROTO(int host, int index, int state, unsigned long capture_idx,
+		 unsigned long dmairq_idx),
+
+	TP_ARGS(host, index, state, capture_idx, dmairq_idx),
+
+	TP_STRUCT__entry(
+		__field(	int,		host		)
+		__field(	int,		index		)
+		__field(	int,		state		)
+		__field(	unsigned long,	capture_idx	)
+		__field(	unsigned long,	dmairq_idx	)
+	),
+
+	TP_fast_assign(
+		__entry->host		= host;
+		__entry->index		= index;
+		__entry->state		= state;
+		__entry->capture_idx	= capture_idx;
+		__entry->dmairq_idx	= dmairq_idx;
+	),
+
+	TP_printk("cif%d vb=%d state=%d capture=%lu dmairq=%lu",
+		  __entry->host, __entry->index, __entry->state,
+		  __entry->capture_idx, __entry->dmairq_idx)
+);
+
+/* vb is queued by user */
+DEFINE_EVENT(rk_camera_buf, rk_camera_buf_queue,
+
+	TP_PROTO(int host, int index, int state, unsigned long capture_idx,
+		 unsigned long dmairq_idx),
+
+	TP_ARGS(host, index, state, capture_idx, dmairq_idx)
+);
+
+/* vb is armed in cif FRM0/FRM1 */
+DEFINE_EVENT(rk_camera_buf, rk_camera_buf_capture,
+
+	TP_PROTO(int host, int index, int state, unsigned long capture_idx,
+		 unsigned long dmairq_idx),
+
+	TP_ARGS(host, index, state, capture_idx, dmairq_idx)
+);
+
+DECLARE_EVENT_CLASS(rk_camera_process,
+
+	TP_PROTO(int host, int index, ktime_t irq_ts, int err),
+
+	TP_ARGS(host, index, irq_ts, err),
+
+	TP_STRUCT__entry(
+		__field(	int,		host		)
+		__field(	int,		index		)
+		__field(	s64,		irq_ts		)
+		__field(	int,		err		)
+	),
+
+	TP_fast_assign(
+		__entry->host		= host;
+		__entry->index		= index;
+		__entry->irq_ts		= ktime_to_ns(irq_ts);
+		__entry->err		= err;
+	),
+
+	TP_printk("cif%d vb=%d irq_ts=%lld err=%d",
+		  __entry->host, __entry->index,
+		  (long long)__entry->irq_ts, __entry->err)
+);
+
+/* rk_camera_capture_process is started, irq_ts is time of frame done irq */
+DEFINE_EVENT(rk_camera_process, rk_camera_process_start,
+
+	TP_PROTO(int host, int index, ktime_t irq_ts, int err),
+
+	TP_ARGS(host, index, irq_ts, err)
+);
+
+/* vb is given back to user */
+DEFINE_EVENT(rk_camera_process, rk_camera_process_done,
+
+	TP_PROTO(int host, int index, ktime_t irq_ts, int err),
+
+	TP_ARGS(host, index, irq_ts, err)
+);
+
+TRACE_EVENT(rk_camera_scale_start,
+
+	TP_PROTO(int host, int index, int engine, int src_w, int src_h,
+		 int dst_w, int dst_h),
+
+	TP_ARGS(host, index, engine, src_w, src_h, dst_w, dst_h),
+
+	TP_STRUCT__entry(
+		__field(	int,		host		)
+		__field(	int,		index		)
+		__field(	int,		engine		)
+		__field(	int,		src_w		)
+		__field(	int,		src_h		)
+		__field(	int,		dst_w		)
+		__field(	int,		dst_h		)
+	),
+
+	TP_fast_assign(
+		__entry->host		= host;
+		__entry->index		= index;
+		__entry->engine		= engine;
+		__entry->src_w		= src_w;
+		__entry->src_h		= src_h;
+		__entry->dst_w		= dst_w;
+		__entry->dst_h		= dst_h;
+	),
+
+	TP_printk("cif%d vb=%d engine=%d %dx%d->%dx%d",
+		  __entry->host, __entry->index, __entry->engine,
+		  __entry->src_w, __entry->src_h,
+		  __entry->dst_w, __entry->dst_h)
+);
+
+TRACE_EVENT(rk_camera_scale_end,
+
+	TP_PROTO(int host, int index, int engine, int ret),
+
+	TP_ARGS(host, index, engine, ret),
+
+	TP_STRUCT__entry(
+		__field(	int,		host		)
+		__field(	int,		index		)
+		__field(	int,		engine		)
+		__field(	int,		ret		)
+	),
+
+	TP_fast_assign(
+		__entry->host		= host;
+		__entry->index		= index;
+		__entry->engine		= engine;
+		__entry->ret		= ret;
+	),
+
+	TP_printk("cif%d vb=%d engine=%d ret=%d",
+		  __entry->host, __entry->index, __entry->engine,
+		  __entry->ret)
+);
+
+#endif /* _TRACE_RK_CAMERA_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,350 @@
+/*
+ * scale_crop_arm_test.c - compare ARM scaler of rk30_camera_oneframe.c with the old one
+ *
+ * The old loop is rk_camera_scale_crop_arm before v0.3.0x18, the new one is
+ * rk_camera_scale_coeff_update + rk_camera_scale_crop_arm_band, frame is split to
+ * bands like rk_camera_scale_crop_arm_rows. Both are copied here without cache
+ * maintenance, keep them in sync with the driver.
+ *
+ * Build and run on host:
+ *     gcc -O2 -Wall -o scale_crop_arm_test scale_crop_arm_test.c && ./scale_crop_arm_test [loops] [seed]
+ *
+ * Return 0 if output of every case is bit exact.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN(x,y)   ((x<y) ? x: y)
+
+struct scale_case {
+    int srcW,srcH;          /* vir_width, vir_height */
+    int left,top;           /* zoominfo.a.c.left/top */
+    int cropW,cropH;        /* zoominfo.a.c.width/height */
+    int dstW,dstH;          /* user_width, user_height */
+    int shift_bits;
+    int bands;
+};
+
+/* old rk_camera_scale_crop_arm, src is vipmem block, dst is videobuf */
+static void scale_old(const struct scale_case *t, unsigned char *src, unsigned char *dst)
+{
+    unsigned char *psY,*pdY,*psUV,*pdUV;
+    int srcW,srcH,cropW,cropH,dstW,dstH;
+    long zoomindstxIntInv,zoomindstyIntInv;
+    long x,y;
+    long yCoeff00,yCoeff01,xCoeff00,xCoeff01;
+    long sX,sY;
+    long r0,r1,a,b,c,d;
+    int shift_bits = t->shift_bits;
+
+    psY = src;
+    psUV = psY + t->srcW*t->srcH;
+
+    srcW = t->srcW;
+    srcH = t->srcH;
+    cropW = t->cropW;
+    cropH = t->cropH;
+
+    psY = psY + t->top*t->srcW+t->left;
+    psUV = psUV + t->top*t->srcW/2+t->left;
+
+    pdY = dst;
+    pdUV = pdY + t->dstW*t->dstH;
+    dstW = t->dstW;
+    dstH = t->dstH;
+
+    zoomindstxIntInv = ((unsigned long)(cropW)<<16)/dstW + 1;
+    zoomindstyIntInv = ((unsigned long)(cropH)<<16)/dstH + 1;
+    //y
+    for(y = 0; y<dstH; y++ ) {
+        yCoeff00 = (y*zoomindstyIntInv)&0xffff;
+        yCoeff01 = 0xffff - yCoeff00;
+        sY = (y*zoomindstyIntInv >> 16);
+        sY = (sY >= srcH - 1)? (srcH - 2) : sY;
+        for(x = 0; x<dstW; x++ ) {
+            xCoeff00 = (x*zoomindstxIntInv)&0xffff;
+            xCoeff01 = 0xffff - xCoeff00;
+            sX = (x*zoomindstxIntInv >> 16);
+            sX = (sX >= srcW -1)?(srcW- 2) : sX;
+            a = (psY[sY*srcW + sX]<<shift_bits);
+            b = (psY[sY*srcW + sX + 1]<<shift_bits);
+            c = (psY[(sY+1)*srcW + sX]<<shift_bits);
+            d = (psY[(sY+1)*srcW + sX + 1]<<shift_bits);
+
+            r0 = (a * xCoeff01 + b * xCoeff00)>>16 ;
+            r1 = (c * xCoeff01 + d * xCoeff00)>>16 ;
+            r0 = (r0 * yCoeff01 + r1 * yCoeff00)>>16;
+
+            pdY[x] = r0;
+        }
+        pdY += dstW;
+    }
+
+    dstW /= 2;
+    dstH /= 2;
+    srcW /= 2;
+    srcH /= 2;
+
+    //UV
+    for(y = 0; y<dstH; y++ ) {
+        yCoeff00 = (y*zoomindstyIntInv)&0xffff;
+        yCoeff01 = 0xffff - yCoeff00;
+        sY = (y*zoomindstyIntInv >> 16);
+        sY = (sY >= srcH -1)? (srcH - 2) : sY;
+        for(x = 0; x<dstW; x++ ) {
+            xCoeff00 = (x*zoomindstxIntInv)&0xffff;
+            xCoeff01 = 0xffff - xCoeff00;
+            sX = (x*zoomindstxIntInv >> 16);
+            sX = (sX >= srcW -1)?(srcW- 2) : sX;
+            //U
+            a = (psUV[(sY*srcW + sX)*2]<<shift_bits);
+            b = (psUV[(sY*srcW + sX + 1)*2]<<shift_bits);
+            c = (psUV[((sY+1)*srcW + sX)*2]<<shift_bits);
+            d = (psUV[((sY+1)*srcW + sX + 1)*2]<<shift_bits);
+
+            r0 = (a * xCoeff01 + b * xCoeff00)>>16 ;
+            r1 = (c * xCoeff01 + d * xCoeff00)>>16 ;
+            r0 = (r0 * yCoeff01 + r1 * yCoeff00)>>16;
+
+            pdUV[x*2] = r0;
+
+            //V
+            a = (psUV[(sY*srcW + sX)*2 + 1]<<shift_bits);
+            b = (psUV[(sY*srcW + sX + 1)*2 + 1]<<shift_bits);
+            c = (psUV[((sY+1)*srcW + sX)*2 + 1]<<shift_bits);
+            d = (psUV[((sY+1)*srcW + sX + 1)*2 + 1]<<shift_bits);
+
+            r0 = (a * xCoeff01 + b * xCoeff00)>>16 ;
+            r1 = (c * xCoeff01 + d * xCoeff00)>>16 ;
+            r0 = (r0 * yCoeff01 + r1 * yCoeff00)>>16;
+
+            pdUV[x*2 + 1] = r0;
+        }
+        pdUV += dstW*2;
+    }
+}
+
+/* rk_camera_scale_coeff */
+struct scale_coeff {
+    unsigned short *x_coeff;
+    unsigned short *y_sx;
+    unsigned short *uv_sx;
+};
+
+/* rk_camera_scale_job */
+struct scale_job {
+    unsigned char *psY,*psUV,*pdY,*pdUV;
+    int srcW,srcH,dstW,dstH;
+    long zoomindstyIntInv;
+    int shift_bits;
+};
+
+/* rk_camera_scale_coeff_update */
+static void coeff_update(struct scale_coeff *coeff, int src_w, int crop_w, int dst_w)
+{
+    long zoomindstxIntInv,sX;
+    int x;
+
+    coeff->x_coeff = malloc(sizeof(unsigned short)*dst_w*3);
+    coeff->y_sx = coeff->x_coeff + dst_w;
+    coeff->uv_sx = coeff->y_sx + dst_w;
+
+    zoomindstxIntInv = ((unsigned long)(crop_w)<<16)/dst_w + 1;
+    for (x=0; x<dst_w; x++) {
+        coeff->x_coeff[x] = (x*zoomindstxIntInv)&0xffff;
+        sX = (x*zoomindstxIntInv >> 16);
+        coeff->y_sx[x] = (sX >= src_w - 1)? (src_w - 2) : sX;
+    }
+    for (x=0; x<dst_w/2; x++) {
+        sX = (x*zoomindstxIntInv >> 16);
+        coeff->uv_sx[x] = ((sX >= src_w/2 - 1)? (src_w/2 - 2) : sX)*2;
+    }
+}
+
+/* rk_camera_scale_crop_arm_band */
+static void scale_band(struct scale_job *job, struct scale_coeff *coeff, int y_start, int y_end)
+{
+    unsigned char *psY,*pdY,*psUV,*pdUV;
+    unsigned char *psRow0,*psRow1,*psPix0,*psPix1;
+    unsigned short *x_coeff,*y_sx,*uv_sx;
+    int srcW,srcH,dstW;
+    long zoomindstyIntInv;
+    long x,y;
+    long yCoeff00,xCoeff00;
+    long sX,sY;
+    long r0,r1,a,b,c,d;
+    int shift_bits;
+
+    psY = job->psY;
+    psUV = job->psUV;
+    srcW = job->srcW;
+    srcH = job->srcH;
+    dstW = job->dstW;
+    zoomindstyIntInv = job->zoomindstyIntInv;
+    shift_bits = job->shift_bits;
+    x_coeff = coeff->x_coeff;
+    y_sx = coeff->y_sx;
+    uv_sx = coeff->uv_sx;
+    pdY = job->pdY + y_start*dstW;
+    pdUV = job->pdUV + (y_start/2)*dstW;
+
+    //y
+    for(y = y_start; y<y_end; y++ ) {
+        yCoeff00 = (y*zoomindstyIntInv)&0xffff;
+        sY = (y*zoomindstyIntInv >> 16);
+        sY = (sY >= srcH - 1)? (srcH - 2) : sY;
+        psRow0 = psY + sY*srcW;
+        psRow1 = psRow0 + srcW;
+        for(x = 0; x<dstW; x++ ) {
+            xCoeff00 = x_coeff[x];
+            sX = y_sx[x];
+            a = (psRow0[sX]<<shift_bits);
+            b = (psRow0[sX + 1]<<shift_bits);
+            c = (psRow1[sX]<<shift_bits);
+            d = (psRow1[sX + 1]<<shift_bits);
+
+            r0 = ((a<<16) - a + (b - a) * xCoeff00)>>16;
+            r1 = ((c<<16) - c + (d - c) * xCoeff00)>>16;
+            r0 = ((r0<<16) - r0 + (r1 - r0) * yCoeff00)>>16;
+
+            pdY[x] = r0;
+        }
+        pdY += dstW;
+    }
+
+    dstW /= 2;
+    srcW /= 2;
+    srcH /= 2;
+
+    //UV
+    for(y = y_start/2; y<y_end/2; y++ ) {
+        yCoeff00 = (y*zoomindstyIntInv)&0xffff;
+        sY = (y*zoomindstyIntInv >> 16);
+        sY = (sY >= srcH -1)? (srcH - 2) : sY;
+        psRow0 = psUV + sY*srcW*2;
+        psRow1 = psRow0 + srcW*2;
+        for(x = 0; x<dstW; x++ ) {
+            xCoeff00 = x_coeff[x];
+            psPix0 = psRow0 + uv_sx[x];
+            psPix1 = psRow1 + uv_sx[x];
+            //U
+            a = (psPix0[0]<<shift_bits);
+            b = (psPix0[2]<<shift_bits);
+            c = (psPix1[0]<<shift_bits);
+            d = (psPix1[2]<<shift_bits);
+
+            r0 = ((a<<16) - a + (b - a) * xCoeff00)>>16;
+            r1 = ((c<<16) - c + (d - c) * xCoeff00)>>16;
+            r0 = ((r0<<16) - r0 + (r1 - r0) * yCoeff00)>>16;
+
+            pdUV[x*2] = r0;
+
+            //V
+            a = (psPix0[1]<<shift_bits);
+            b = (psPix0[3]<<shift_bits);
+            c = (psPix1[1]<<shift_bits);
+            d = (psPix1[3]<<shift_bits);
+
+            r0 = ((a<<16) - a + (b - a) * xCoeff00)>>16;
+            r1 = ((c<<16) - c + (d - c) * xCoeff00)>>16;
+            r0 = ((r0<<16) - r0 + (r1 - r0) * yCoeff00)>>16;
+
+            pdUV[x*2 + 1] = r0;
+        }
+        pdUV += dstW*2;
+    }
+}
+
+/* rk_camera_scale_crop_arm_rows(work, 0, user_height) without cache maintenance */
+static void scale_new(const struct scale_case *t, unsigned char *src, unsigned char *dst)
+{
+    struct scale_job job;
+    struct scale_coeff coeff;
+    int y_start = 0, y_end = t->dstH;
+    int band_h,i;
+
+    job.psUV = src + t->srcW*t->srcH;
+    job.srcW = t->srcW;
+    job.srcH = t->srcH;
+    job.psY = src + t->top*t->srcW+t->left;
+    job.psUV = job.psUV + t->top*t->srcW/2+t->left;
+    job.pdY = dst;
+    job.pdUV = dst + t->dstW*t->dstH;
+    job.dstW = t->dstW;
+    job.dstH = t->dstH;
+    job.zoomindstyIntInv = ((unsigned long)(t->cropH)<<16)/job.dstH + 1;
+    job.shift_bits = t->shift_bits;
+
+    coeff_update(&coeff, t->srcW, t->cropW, t->dstW);
+
+    band_h = ((y_end - y_start + t->bands - 1)/t->bands + 1) & (~0x01);
+    for (i=0; i<t->bands; i++) {
+        scale_band(&job, &coeff, MIN(y_start + i*band_h, y_end),
+                   (i == t->bands - 1) ? y_end : MIN(y_start + (i+1)*band_h, y_end));
+    }
+
+    free(coeff.x_coeff);
+}
+
+static int rand_even(int lo, int hi)
+{
+    return (lo + rand()%(hi - lo + 1)) & (~0x01);
+}
+
+int main(int argc, char **argv)
+{
+    int loops = (argc > 1) ? atoi(argv[1]) : 2000;
+    unsigned int seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+    struct scale_case t;
+    unsigned char *src,*dst_old,*dst_new;
+    size_t src_size,dst_size,i;
+    int n,fail = 0;
+
+    srand(seed);
+    for (n=0; n<loops; n++) {
+        t.srcW = rand_even(8, 1280);
+        t.srcH = rand_even(8, 960);
+        /* digital zoom crops center of src, scale ratio is 1/4..4 */
+        t.cropW = rand_even(4, t.srcW);
+        t.cropH = rand_even(4, t.srcH);
+        t.left = ((t.srcW - t.cropW)>>1)&(~0x01);
+        t.top = ((t.srcH - t.cropH)>>1)&(~0x01);
+        t.dstW = MIN(rand_even(t.cropW/4 + 4, t.cropW*4), 2560);
+        t.dstH = MIN(rand_even(t.cropH/4 + 4, t.cropH*4), 1920);
+        t.shift_bits = (rand()&1) ? 2 : 0;
+        t.bands = 1 + rand()%4;
+
+        /* crop offset isn't clamped by the scaler, so src is padded like vipmem block */
+        src_size = (size_t)t.srcW*t.srcH*3;
+        dst_size = (size_t)t.dstW*t.dstH*3/2;
+        src = malloc(src_size);
+        dst_old = malloc(dst_size);
+        dst_new = malloc(dst_size);
+        for (i=0; i<src_size; i++)
+            src[i] = rand();
+        memset(dst_old, 0x5a, dst_size);
+        memset(dst_new, 0xa5, dst_size);
+
+        scale_old(&t, src, dst_old);
+        scale_new(&t, src, dst_new);
+
+        if (memcmp(dst_old, dst_new, dst_size)) {
+            for (i=0; i<dst_size; i++)
+                if (dst_old[i] != dst_new[i])
+                    break;
+            printf("FAIL: src %dx%d crop %dx%d@(%d,%d) dst %dx%d shift %d bands %d: first diff at %zu (%d != %d)\n",
+                   t.srcW, t.srcH, t.cropW, t.cropH, t.left, t.top, t.dstW, t.dstH,
+                   t.shift_bits, t.bands, i, dst_old[i], dst_new[i]);
+            fail++;
+        }
+
+        free(src);
+        free(dst_old);
+        free(dst_new);
+    }
+
+    printf("%d/%d cases bit exact (seed %u)\n", loops - fail, loops, seed);
+    return fail ? 1 : 0;
+}